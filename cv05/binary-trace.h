@@ -0,0 +1,428 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include "ns3/core-module.h"
+#include "ns3/csma-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/wifi-module.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Binary replacement of the ascii traces of AsciiTraceHelper (EnableAsciiAll).
+ *
+ * The file starts with BINARY_TRACE_MAGIC followed by records made of a fixed
+ * BinaryTraceRecord and, for events, the serialized packet. Context strings (the
+ * config paths printed by the ascii traces) and wifi modes are interned: the first
+ * use of a string emits a CONTEXT record carrying it, later records only refer to
+ * its id. trace-expand turns a binary trace back into the text of the ascii trace.
+ */
+const char BINARY_TRACE_MAGIC[8] = {'N', 'S', '3', 'B', 'T', 'R', 'C', '1'};
+
+struct BinaryTraceRecord
+{
+    enum Kind : uint8_t
+    {
+        CONTEXT = 'C', // string of id context, size bytes follow
+        ENQUEUE = '+',
+        DEQUEUE = '-',
+        DROP = 'd',
+        RECEIVE = 'r',
+        WIFI_TX = 't', // "t time context mode packet fcs"
+        WIFI_RX = 'R', // "r time mode context packet fcs"
+    };
+
+    int64_t time;     // ns
+    uint32_t context; // interned config path
+    uint32_t mode;    // interned wifi mode, wifi events only
+    uint32_t size;    // bytes following the record
+    uint8_t kind;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(BinaryTraceRecord) == 24, "BinaryTraceRecord must stay 24 bytes");
+
+/**
+ * Writes a binary trace. The simulator thread only appends records to a chunk;
+ * full chunks are handed to a writer thread through a single-producer
+ * single-consumer ring and recycled through a second one. The writer sleeps on
+ * a condition variable while the ring is empty, like the RotatingPcapWriter of
+ * cv07, and the simulator thread only takes the mutex to wake it up.
+ */
+class BinaryTraceWriter : public SimpleRefCount<BinaryTraceWriter>
+{
+  public:
+    BinaryTraceWriter(std::string filename);
+    ~BinaryTraceWriter();
+
+    // Connect the traces EnableAsciiAll of the respective helper would connect
+    void EnableCsmaAll();
+    void EnablePointToPointAll();
+    void EnableWifiAll();
+    void Close();
+
+  private:
+    static const uint32_t CHUNK_SIZE = 1 << 20;
+    static const uint32_t QUEUE_SIZE = 64; // power of two
+
+    struct ChunkQueue
+    {
+        std::vector<uint8_t>* slots[QUEUE_SIZE];
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+
+        bool Push(std::vector<uint8_t>* chunk);
+        std::vector<uint8_t>* Pop();
+    };
+
+    uint32_t Intern(const std::string& s);
+    uint8_t* Reserve(uint32_t bytes);
+    void Event(uint8_t kind, uint32_t context, uint32_t mode, Ptr<const Packet> p);
+    void Flush();
+    void Write();
+
+    static void Queue(BinaryTraceWriter* w, uint8_t kind, uint32_t context, Ptr<const Packet> p);
+    static void WifiTx(BinaryTraceWriter* w,
+                       uint32_t context,
+                       Ptr<const Packet> p,
+                       WifiMode mode,
+                       WifiPreamble preamble,
+                       uint8_t txLevel);
+    static void WifiRx(BinaryTraceWriter* w,
+                       uint32_t context,
+                       Ptr<const Packet> p,
+                       double snr,
+                       WifiMode mode,
+                       WifiPreamble preamble);
+
+    FILE* m_file;
+    std::unordered_map<std::string, uint32_t> m_strings;
+    std::vector<uint8_t>* m_chunk;
+    ChunkQueue m_full; // simulator thread -> writer thread
+    ChunkQueue m_free; // writer thread -> simulator thread
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_sleeping;
+    bool m_done; // guarded by m_mutex
+    std::thread m_writer;
+};
+
+inline bool
+BinaryTraceWriter::ChunkQueue::Push(std::vector<uint8_t>* chunk)
+{
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == QUEUE_SIZE)
+    {
+        return false;
+    }
+    slots[h & (QUEUE_SIZE - 1)] = chunk;
+    // seq_cst pairs with the writer announcing it sleeps, so one of them sees the other
+    head.store(h + 1, std::memory_order_seq_cst);
+    return true;
+}
+
+inline std::vector<uint8_t>*
+BinaryTraceWriter::ChunkQueue::Pop()
+{
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+    std::vector<uint8_t>* chunk = slots[t & (QUEUE_SIZE - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return chunk;
+}
+
+inline BinaryTraceWriter::BinaryTraceWriter(std::string filename)
+    : m_file(fopen(filename.c_str(), "wb")),
+      m_chunk(new std::vector<uint8_t>()),
+      m_sleeping(false),
+      m_done(false)
+{
+    NS_ABORT_MSG_IF(m_file == nullptr, "Can't open " << filename);
+    fwrite(BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC), 1, m_file);
+    m_chunk->reserve(CHUNK_SIZE);
+    m_writer = std::thread(&BinaryTraceWriter::Write, this);
+}
+
+inline BinaryTraceWriter::~BinaryTraceWriter()
+{
+    Close();
+}
+
+inline void
+BinaryTraceWriter::Close()
+{
+    if (!m_writer.joinable())
+    {
+        return;
+    }
+    Flush();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+        m_wake.notify_one();
+    }
+    m_writer.join();
+    while (std::vector<uint8_t>* chunk = m_free.Pop())
+    {
+        delete chunk;
+    }
+    delete m_chunk;
+    m_chunk = nullptr;
+    fclose(m_file);
+}
+
+inline uint8_t*
+BinaryTraceWriter::Reserve(uint32_t bytes)
+{
+    if (m_chunk->size() + bytes > CHUNK_SIZE && !m_chunk->empty())
+    {
+        Flush();
+    }
+    size_t used = m_chunk->size();
+    m_chunk->resize(used + bytes);
+    return m_chunk->data() + used;
+}
+
+inline void
+BinaryTraceWriter::Flush()
+{
+    if (m_chunk->empty())
+    {
+        return;
+    }
+    while (!m_full.Push(m_chunk))
+    {
+        std::this_thread::yield();
+    }
+    if (m_sleeping.load(std::memory_order_seq_cst))
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_one();
+    }
+    m_chunk = m_free.Pop();
+    if (m_chunk == nullptr)
+    {
+        m_chunk = new std::vector<uint8_t>();
+        m_chunk->reserve(CHUNK_SIZE);
+    }
+}
+
+inline void
+BinaryTraceWriter::Write()
+{
+    while (true)
+    {
+        std::vector<uint8_t>* chunk = m_full.Pop();
+        if (chunk == nullptr)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_sleeping.store(true, std::memory_order_seq_cst);
+            bool empty = m_full.head.load(std::memory_order_seq_cst) ==
+                         m_full.tail.load(std::memory_order_relaxed);
+            if (empty && m_done)
+            {
+                break;
+            }
+            if (empty)
+            {
+                m_wake.wait(lock);
+            }
+            m_sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        fwrite(chunk->data(), 1, chunk->size(), m_file);
+        chunk->clear();
+        if (!m_free.Push(chunk))
+        {
+            delete chunk;
+        }
+    }
+}
+
+inline uint32_t
+BinaryTraceWriter::Intern(const std::string& s)
+{
+    auto it = m_strings.find(s);
+    if (it != m_strings.end())
+    {
+        return it->second;
+    }
+    uint32_t id = m_strings.size();
+    m_strings.emplace(s, id);
+    BinaryTraceRecord r{};
+    r.kind = BinaryTraceRecord::CONTEXT;
+    r.context = id;
+    r.size = s.size();
+    uint8_t* p = Reserve(sizeof(r) + s.size());
+    std::memcpy(p, &r, sizeof(r));
+    std::memcpy(p + sizeof(r), s.data(), s.size());
+    return id;
+}
+
+inline void
+BinaryTraceWriter::Event(uint8_t kind, uint32_t context, uint32_t mode, Ptr<const Packet> packet)
+{
+    // packet and metadata are serialized as is, printing them is left to trace-expand
+    BinaryTraceRecord r{};
+    r.time = Simulator::Now().GetNanoSeconds();
+    r.context = context;
+    r.mode = mode;
+    r.kind = kind;
+    r.size = packet->GetSerializedSize();
+    uint8_t* p = Reserve(sizeof(r) + r.size);
+    if (packet->Serialize(p + sizeof(r), r.size) == 0)
+    {
+        r.size = 0;
+        m_chunk->resize(m_chunk->size() - packet->GetSerializedSize());
+    }
+    std::memcpy(p, &r, sizeof(r));
+}
+
+inline void
+BinaryTraceWriter::Queue(BinaryTraceWriter* w, uint8_t kind, uint32_t context, Ptr<const Packet> p)
+{
+    w->Event(kind, context, 0, p);
+}
+
+inline void
+BinaryTraceWriter::WifiTx(BinaryTraceWriter* w,
+                          uint32_t context,
+                          Ptr<const Packet> p,
+                          WifiMode mode,
+                          WifiPreamble preamble,
+                          uint8_t txLevel)
+{
+    w->Event(BinaryTraceRecord::WIFI_TX, context, w->Intern(mode.GetUniqueName()), p);
+}
+
+inline void
+BinaryTraceWriter::WifiRx(BinaryTraceWriter* w,
+                          uint32_t context,
+                          Ptr<const Packet> p,
+                          double snr,
+                          WifiMode mode,
+                          WifiPreamble preamble)
+{
+    w->Event(BinaryTraceRecord::WIFI_RX, context, w->Intern(mode.GetUniqueName()), p);
+}
+
+inline void
+BinaryTraceWriter::EnableCsmaAll()
+{
+    for (auto node = NodeList::Begin(); node != NodeList::End(); ++node)
+    {
+        for (uint32_t i = 0; i < (*node)->GetNDevices(); ++i)
+        {
+            if (!DynamicCast<CsmaNetDevice>((*node)->GetDevice(i)))
+            {
+                continue;
+            }
+            std::ostringstream oss;
+            oss << "/NodeList/" << (*node)->GetId() << "/DeviceList/" << i << "/$ns3::CsmaNetDevice/";
+            std::string base = oss.str();
+            std::pair<const char*, uint8_t> traces[] = {{"MacRx", BinaryTraceRecord::RECEIVE},
+                                                        {"TxQueue/Enqueue", BinaryTraceRecord::ENQUEUE},
+                                                        {"TxQueue/Dequeue", BinaryTraceRecord::DEQUEUE},
+                                                        {"TxQueue/Drop", BinaryTraceRecord::DROP}};
+            for (const auto& trace : traces)
+            {
+                std::string path = base + trace.first;
+                Config::ConnectWithoutContext(
+                    path,
+                    MakeBoundCallback(&BinaryTraceWriter::Queue, this, trace.second, Intern(path)));
+            }
+        }
+    }
+}
+
+inline void
+BinaryTraceWriter::EnablePointToPointAll()
+{
+    for (auto node = NodeList::Begin(); node != NodeList::End(); ++node)
+    {
+        for (uint32_t i = 0; i < (*node)->GetNDevices(); ++i)
+        {
+            if (!DynamicCast<PointToPointNetDevice>((*node)->GetDevice(i)))
+            {
+                continue;
+            }
+            std::ostringstream oss;
+            oss << "/NodeList/" << (*node)->GetId() << "/DeviceList/" << i
+                << "/$ns3::PointToPointNetDevice/";
+            std::string base = oss.str();
+            std::pair<const char*, uint8_t> traces[] = {{"MacRx", BinaryTraceRecord::RECEIVE},
+                                                        {"TxQueue/Enqueue", BinaryTraceRecord::ENQUEUE},
+                                                        {"TxQueue/Dequeue", BinaryTraceRecord::DEQUEUE},
+                                                        {"TxQueue/Drop", BinaryTraceRecord::DROP},
+                                                        {"PhyRxDrop", BinaryTraceRecord::DROP}};
+            for (const auto& trace : traces)
+            {
+                std::string path = base + trace.first;
+                Config::ConnectWithoutContext(
+                    path,
+                    MakeBoundCallback(&BinaryTraceWriter::Queue, this, trace.second, Intern(path)));
+            }
+        }
+    }
+}
+
+inline void
+BinaryTraceWriter::EnableWifiAll()
+{
+    for (auto node = NodeList::Begin(); node != NodeList::End(); ++node)
+    {
+        for (uint32_t i = 0; i < (*node)->GetNDevices(); ++i)
+        {
+            if (!DynamicCast<WifiNetDevice>((*node)->GetDevice(i)))
+            {
+                continue;
+            }
+            std::ostringstream oss;
+            oss << "/NodeList/" << (*node)->GetId() << "/DeviceList/" << i
+                << "/$ns3::WifiNetDevice/Phy/State/";
+            std::string rx = oss.str() + "RxOk";
+            std::string tx = oss.str() + "Tx";
+            Config::ConnectWithoutContext(
+                rx,
+                MakeBoundCallback(&BinaryTraceWriter::WifiRx, this, Intern(rx)));
+            Config::ConnectWithoutContext(
+                tx,
+                MakeBoundCallback(&BinaryTraceWriter::WifiTx, this, Intern(tx)));
+        }
+    }
+}
+
+} // namespace ns3
+
+#endif /* BINARY_TRACE_H */
@@ -20,9 +20,20 @@
 #include "ns3/mobility-module.h"
 #include "ns3/network-module.h"
 #include "ns3/point-to-point-module.h"
+#include "ns3/multi-model-spectrum-channel.h"
+#include "ns3/propagation-module.h"
+#include "ns3/spectrum-wifi-helper.h"
 #include "ns3/ssid.h"
 #include "ns3/yans-wifi-helper.h"
 #include "ns3/netanim-module.h"
+#include "binary-trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // Default Network Topology
 //
@@ -34,11 +45,201 @@
 //                   point-to-point  |    |    |    |
 //                                   ================
 //                                     LAN 10.1.2.0
+//
+// With --nBss=N the STAs are split between N BSSs placed bssDistance apart; the
+// AP of BSS i > 0 is a separate node linked to n0 over 10.2.i.0, its STAs use
+// 10.1.(3 + i).0.
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("ThirdScriptExample");
 
+/**
+ * LogDistancePropagationLossModel that computes the loss of one transmission towards all
+ * receivers in a single pass.
+ *
+ * YansWifiChannel asks for the loss receiver by receiver, and every call goes through
+ * GetPosition of both mobility models. This model keeps the last course change of every node
+ * (position, velocity and time, as reported by the CourseChange trace) in a structure of
+ * arrays. On the first request for a transmitter at a given time it computes the positions,
+ * distances and losses towards all known nodes in one loop over contiguous arrays; the
+ * remaining receivers of the same transmission are then served from that row. The loop calls
+ * std::sqrt and std::log10, so it is only vectorized with -ffast-math (or a vector math
+ * library), which the ns-3 build does not use; the gain comes from the saved GetPosition calls
+ * and map lookups. Positions between course changes are extrapolated from the last reported
+ * velocity segment. For the constant-position and random walk/direction models used here this
+ * is the same motion, but not the same arithmetic as the incremental updates of
+ * ConstantVelocityHelper, so positions and losses of moving nodes can differ in the last bits
+ * from LogDistancePropagationLossModel, and a reception right at a threshold can go the other way.
+ */
+class CachedLogDistancePropagationLossModel : public PropagationLossModel
+{
+  public:
+    static TypeId GetTypeId();
+    CachedLogDistancePropagationLossModel();
+
+  private:
+    double DoCalcRxPower(double txPowerDbm,
+                         Ptr<MobilityModel> a,
+                         Ptr<MobilityModel> b) const override;
+    int64_t DoAssignStreams(int64_t stream) override;
+
+    uint32_t GetIndex(Ptr<MobilityModel> model) const;
+    void CourseChange(Ptr<const MobilityModel> model);
+    void ComputeRow(uint32_t tx) const;
+
+    double m_exponent;
+    double m_referenceDistance;
+    double m_referenceLoss;
+
+    // one entry per node, filled on first use and refreshed on every course change
+    mutable std::unordered_map<const MobilityModel*, uint32_t> m_index;
+    mutable std::vector<double> m_x, m_y, m_z;
+    mutable std::vector<double> m_vx, m_vy, m_vz;
+    mutable std::vector<double> m_t; // time of the last course change [s]
+
+    // losses [dB] of the last transmission, the transmitter is kept as its mobility model so
+    // the receivers of that transmission only need the index lookup of the receiver
+    mutable std::vector<double> m_row;
+    mutable const MobilityModel* m_rowTx;
+    mutable Time m_rowTime;
+    mutable bool m_rowValid;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CachedLogDistancePropagationLossModel);
+
+TypeId
+CachedLogDistancePropagationLossModel::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::CachedLogDistancePropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .AddConstructor<CachedLogDistancePropagationLossModel>()
+            .AddAttribute("Exponent",
+                          "The exponent of the Path Loss propagation model",
+                          DoubleValue(3.0),
+                          MakeDoubleAccessor(&CachedLogDistancePropagationLossModel::m_exponent),
+                          MakeDoubleChecker<double>())
+            .AddAttribute(
+                "ReferenceDistance",
+                "The distance at which the reference loss is calculated (m)",
+                DoubleValue(1.0),
+                MakeDoubleAccessor(&CachedLogDistancePropagationLossModel::m_referenceDistance),
+                MakeDoubleChecker<double>())
+            .AddAttribute(
+                "ReferenceLoss",
+                "The reference loss at reference distance (dB). (Default is Friis at 1m with "
+                "5.15 GHz)",
+                DoubleValue(46.6777),
+                MakeDoubleAccessor(&CachedLogDistancePropagationLossModel::m_referenceLoss),
+                MakeDoubleChecker<double>());
+    return tid;
+}
+
+CachedLogDistancePropagationLossModel::CachedLogDistancePropagationLossModel()
+    : m_rowTx(nullptr),
+      m_rowValid(false)
+{
+}
+
+int64_t
+CachedLogDistancePropagationLossModel::DoAssignStreams(int64_t stream)
+{
+    return 0;
+}
+
+uint32_t
+CachedLogDistancePropagationLossModel::GetIndex(Ptr<MobilityModel> model) const
+{
+    auto it = m_index.find(PeekPointer(model));
+    if (it != m_index.end())
+    {
+        return it->second;
+    }
+    uint32_t index = m_x.size();
+    m_index.emplace(PeekPointer(model), index);
+    m_x.push_back(0);
+    m_y.push_back(0);
+    m_z.push_back(0);
+    m_vx.push_back(0);
+    m_vy.push_back(0);
+    m_vz.push_back(0);
+    m_t.push_back(0);
+    m_row.push_back(0);
+    const_cast<CachedLogDistancePropagationLossModel*>(this)->CourseChange(model);
+    model->TraceConnectWithoutContext(
+        "CourseChange",
+        MakeCallback(&CachedLogDistancePropagationLossModel::CourseChange,
+                     const_cast<CachedLogDistancePropagationLossModel*>(this)));
+    return index;
+}
+
+void
+CachedLogDistancePropagationLossModel::CourseChange(Ptr<const MobilityModel> model)
+{
+    uint32_t i = m_index.at(PeekPointer(model));
+    Vector position = model->GetPosition();
+    Vector velocity = model->GetVelocity();
+    m_x[i] = position.x;
+    m_y[i] = position.y;
+    m_z[i] = position.z;
+    m_vx[i] = velocity.x;
+    m_vy[i] = velocity.y;
+    m_vz[i] = velocity.z;
+    m_t[i] = Simulator::Now().GetSeconds();
+    m_rowValid = false;
+}
+
+void
+CachedLogDistancePropagationLossModel::ComputeRow(uint32_t tx) const
+{
+    const uint32_t n = m_x.size();
+    const double now = Simulator::Now().GetSeconds();
+    const double dt = now - m_t[tx];
+    const double tx0 = m_x[tx] + m_vx[tx] * dt;
+    const double ty0 = m_y[tx] + m_vy[tx] * dt;
+    const double tz0 = m_z[tx] + m_vz[tx] * dt;
+    const double slope = 10 * m_exponent;
+    const double refDistance = m_referenceDistance;
+    const double refLoss = m_referenceLoss;
+    const double* x = m_x.data();
+    const double* y = m_y.data();
+    const double* z = m_z.data();
+    const double* vx = m_vx.data();
+    const double* vy = m_vy.data();
+    const double* vz = m_vz.data();
+    const double* t = m_t.data();
+    double* row = m_row.data();
+    for (uint32_t j = 0; j < n; ++j)
+    {
+        double d = now - t[j];
+        double dx = x[j] + vx[j] * d - tx0;
+        double dy = y[j] + vy[j] * d - ty0;
+        double dz = z[j] + vz[j] * d - tz0;
+        double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        // same as LogDistancePropagationLossModel, no extra loss below the reference distance
+        double ratio = std::max(distance, refDistance) / refDistance;
+        row[j] = refLoss + slope * std::log10(ratio);
+    }
+    m_rowTime = Simulator::Now();
+    m_rowValid = true;
+}
+
+double
+CachedLogDistancePropagationLossModel::DoCalcRxPower(double txPowerDbm,
+                                                     Ptr<MobilityModel> a,
+                                                     Ptr<MobilityModel> b) const
+{
+    // first, as adding a new receiver invalidates the row
+    uint32_t rx = GetIndex(b);
+    if (!m_rowValid || m_rowTx != PeekPointer(a) || m_rowTime != Simulator::Now())
+    {
+        ComputeRow(GetIndex(a));
+        m_rowTx = PeekPointer(a);
+    }
+    return txPowerDbm - m_row[rx];
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -47,6 +248,16 @@ main(int argc, char* argv[])
     uint32_t nWifi = 3;
     bool tracing = true;
     bool ascii = false;
+    bool binaryAscii = false;
+    bool cachedLoss = false;
+    uint32_t nBss = 1;
+    double bssDistance = 100.0;
+    bool spectrumChannel = false;
+    double maxLossDb = 0.0;
+    bool animationEnabled = true;
+    bool animPackets = true;
+    uint64_t animMaxPktsPerFile = 100000;
+    Time animPollInterval = Seconds(0.25);
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("nCsma", "Number of \"extra\" CSMA nodes/devices", nCsma);
@@ -54,16 +265,51 @@ main(int argc, char* argv[])
     cmd.AddValue("verbose", "Tell echo applications to log if true", verbose);
     cmd.AddValue("tracing", "Enable pcap tracing", tracing);
     cmd.AddValue("ascii", "Enable ascii", ascii);
+    cmd.AddValue("animation", "Write the NetAnim trace", animationEnabled);
+    cmd.AddValue("animPackets",
+                 "animation: include the packet events, otherwise only nodes and positions",
+                 animPackets);
+    cmd.AddValue("animMaxPktsPerFile",
+                 "animation: packets per trace file before the next file is started",
+                 animMaxPktsPerFile);
+    cmd.AddValue("animPollInterval",
+                 "animation: interval between two position samples of the mobile nodes",
+                 animPollInterval);
+    cmd.AddValue("cachedLoss",
+                 "Compute the wifi path loss of a transmission towards all receivers at once "
+                 "(CachedLogDistancePropagationLossModel)",
+                 cachedLoss);
+    cmd.AddValue("nBss",
+                 "Number of BSSs, the first AP is n0, the others hang off n0 on their own "
+                 "point-to-point links; the STAs are split evenly between them",
+                 nBss);
+    cmd.AddValue("bssDistance",
+                 "Distance in m between the grids of two neighbouring BSSs",
+                 bssDistance);
+    cmd.AddValue("spectrumChannel",
+                 "Use SpectrumWifiPhy on a MultiModelSpectrumChannel instead of the YANS channel",
+                 spectrumChannel);
+    cmd.AddValue("maxLossDb",
+                 "spectrumChannel: receivers behind more than this path loss get no receive "
+                 "event at all, 0 disables the cutoff",
+                 maxLossDb);
+    cmd.AddValue("binaryAscii",
+                 "Write the ascii traces in binary (s3_*.trb), expand them with trace-expand",
+                 binaryAscii);
 
     cmd.Parse(argc, argv);
 
-    // The underlying restriction of 18 is due to the grid position
-    // allocator's configuration; the grid layout will exceed the
-    // bounding box if more than 18 nodes are provided.
-    if (nWifi > 18)
+    // Each BSS gets its own 10.1.(3 + i).0 and 10.2.i.0 subnets
+    if (nBss == 0 || nBss > 200 || nWifi < nBss)
+    {
+        std::cout << "nBss should be between 1 and 200 and not exceed nWifi" << std::endl;
+        return 1;
+    }
+    // A /24 holds 254 hosts: the STAs of the largest BSS and its AP
+    if ((nWifi + nBss - 1) / nBss > 253)
     {
-        std::cout << "nWifi should be 18 or less; otherwise grid layout exceeds the bounding box"
-                  << std::endl;
+        std::cout << "At most 253 STAs per BSS fit into its /24, increase nBss to at least "
+                  << (nWifi + 252) / 253 << std::endl;
         return 1;
     }
 
@@ -97,39 +343,81 @@ main(int argc, char* argv[])
     NodeContainer wifiStaNodes;
     wifiStaNodes.Create(nWifi);
     NodeContainer wifiApNode = p2pNodes.Get(0);
+    NodeContainer extraApNodes;
+    extraApNodes.Create(nBss - 1);
+    wifiApNode.Add(extraApNodes);
 
-    YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
-    YansWifiPhyHelper phy;
-    phy.SetChannel(channel.Create());
+    std::vector<NetDeviceContainer> backhaulDevices;
+    for (uint32_t i = 1; i < nBss; ++i)
+    {
+        backhaulDevices.push_back(pointToPoint.Install(p2pNodes.Get(0), wifiApNode.Get(i)));
+    }
 
-    WifiMacHelper mac;
-    Ssid ssid = Ssid("ns-3-ssid");
+    YansWifiPhyHelper yansPhy;
+    SpectrumWifiPhyHelper spectrumPhy;
+    if (spectrumChannel)
+    {
+        // Unlike the YANS channel, which schedules a receive event on every PHY and only then
+        // compares the power with the sensitivity, the spectrum channel drops the receivers
+        // beyond MaxLossDb while it computes the loss
+        Ptr<MultiModelSpectrumChannel> spectrum = CreateObject<MultiModelSpectrumChannel>();
+        Ptr<PropagationLossModel> loss;
+        if (cachedLoss)
+        {
+            loss = CreateObject<CachedLogDistancePropagationLossModel>();
+        }
+        else
+        {
+            loss = CreateObject<LogDistancePropagationLossModel>();
+        }
+        spectrum->AddPropagationLossModel(loss);
+        spectrum->SetPropagationDelayModel(CreateObject<ConstantSpeedPropagationDelayModel>());
+        if (maxLossDb > 0)
+        {
+            spectrum->SetAttribute("MaxLossDb", DoubleValue(maxLossDb));
+        }
+        spectrumPhy.SetChannel(spectrum);
+    }
+    else
+    {
+        YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
+        if (cachedLoss)
+        {
+            // Default () with the log-distance loss replaced by its cached variant
+            channel = YansWifiChannelHelper();
+            channel.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
+            channel.AddPropagationLoss("ns3::CachedLogDistancePropagationLossModel");
+        }
+        yansPhy.SetChannel(channel.Create());
+    }
+    WifiPhyHelper& phy = spectrumChannel ? static_cast<WifiPhyHelper&>(spectrumPhy) : yansPhy;
 
+    WifiMacHelper mac;
     WifiHelper wifi;
 
-    NetDeviceContainer staDevices;
-    mac.SetType("ns3::StaWifiMac", "Ssid", SsidValue(ssid), "ActiveProbing", BooleanValue(false));
-    staDevices = wifi.Install(phy, mac, wifiStaNodes);
+    // The STAs are split into contiguous blocks, one per BSS
+    std::vector<NodeContainer> bssStaNodes(nBss);
+    for (uint32_t i = 0; i < nWifi; ++i)
+    {
+        bssStaNodes[static_cast<uint64_t>(i) * nBss / nWifi].Add(wifiStaNodes.Get(i));
+    }
 
+    std::vector<NetDeviceContainer> bssStaDevices(nBss);
     NetDeviceContainer apDevices;
-    mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-    apDevices = wifi.Install(phy, mac, wifiApNode);
+    for (uint32_t i = 0; i < nBss; ++i)
+    {
+        Ssid ssid = Ssid(i == 0 ? "ns-3-ssid" : "ns-3-ssid-" + std::to_string(i));
+        mac.SetType("ns3::StaWifiMac",
+                    "Ssid",
+                    SsidValue(ssid),
+                    "ActiveProbing",
+                    BooleanValue(false));
+        bssStaDevices[i] = wifi.Install(phy, mac, bssStaNodes[i]);
+
+        mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
+        apDevices.Add(wifi.Install(phy, mac, wifiApNode.Get(i)));
+    }
 
-    MobilityHelper mobility;
-   
-    mobility.SetPositionAllocator("ns3::GridPositionAllocator",
-                                  "MinX",
-                                  DoubleValue(0.0),
-                                  "MinY",
-                                  DoubleValue(0.0),
-                                  "DeltaX",
-                                  DoubleValue(5.0),
-                                  "DeltaY",
-                                  DoubleValue(10.0),
-                                  "GridWidth",
-                                  UintegerValue(3),
-                                  "LayoutType",
-                                  StringValue("RowFirst"));
     double min = 5.0;
     double max = 20.0;
  
@@ -137,15 +425,42 @@ main(int argc, char* argv[])
     RandomSpeed->SetAttribute ("Min", DoubleValue (min));
     RandomSpeed->SetAttribute ("Max", DoubleValue (max));
 
-    mobility.SetMobilityModel("ns3::RandomWalk2dMobilityModel",
-                              "Bounds",
-                              RectangleValue(Rectangle(-50, 50, -50, 50)),
-                              "Speed",
-                              PointerValue(RandomSpeed));
-    mobility.Install(wifiStaNodes);
-
-    mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
-    mobility.Install(wifiApNode);
+    for (uint32_t i = 0; i < nBss; ++i)
+    {
+        // Up to 18 STAs the grid is 3 wide and fits the original 100 m x 100 m box, larger
+        // BSSs get a roughly square grid and a box grown to contain it
+        uint32_t nSta = bssStaNodes[i].GetN();
+        uint32_t gridWidth =
+            nSta <= 18 ? 3 : static_cast<uint32_t>(std::ceil(std::sqrt(2.0 * nSta)));
+        uint32_t gridRows = (nSta + gridWidth - 1) / gridWidth;
+        double minX = i * bssDistance;
+        double maxX = minX + std::max(50.0, 5.0 * (gridWidth - 1));
+        double maxY = std::max(50.0, 10.0 * (gridRows - 1));
+
+        MobilityHelper mobility;
+        mobility.SetPositionAllocator("ns3::GridPositionAllocator",
+                                      "MinX",
+                                      DoubleValue(minX),
+                                      "MinY",
+                                      DoubleValue(0.0),
+                                      "DeltaX",
+                                      DoubleValue(5.0),
+                                      "DeltaY",
+                                      DoubleValue(10.0),
+                                      "GridWidth",
+                                      UintegerValue(gridWidth),
+                                      "LayoutType",
+                                      StringValue("RowFirst"));
+        mobility.SetMobilityModel("ns3::RandomWalk2dMobilityModel",
+                                  "Bounds",
+                                  RectangleValue(Rectangle(minX - 50, maxX, -50, maxY)),
+                                  "Speed",
+                                  PointerValue(RandomSpeed));
+        mobility.Install(bssStaNodes[i]);
+
+        mobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+        mobility.Install(wifiApNode.Get(i));
+    }
     MobilityHelper mobility2;
     mobility2.SetPositionAllocator("ns3::GridPositionAllocator",
                                   "MinX",
@@ -180,9 +495,18 @@ main(int argc, char* argv[])
     Ipv4InterfaceContainer csmaInterfaces;
     csmaInterfaces = address.Assign(csmaDevices);
 
-    address.SetBase("10.1.3.0", "255.255.255.0");
-    address.Assign(staDevices);
-    address.Assign(apDevices);
+    for (uint32_t i = 0; i < nBss; ++i)
+    {
+        address.SetBase(("10.1." + std::to_string(3 + i) + ".0").c_str(), "255.255.255.0");
+        address.Assign(bssStaDevices[i]);
+        address.Assign(apDevices.Get(i));
+    }
+
+    for (uint32_t i = 0; i < backhaulDevices.size(); ++i)
+    {
+        address.SetBase(("10.2." + std::to_string(1 + i) + ".0").c_str(), "255.255.255.0");
+        address.Assign(backhaulDevices[i]);
+    }
 
     UdpEchoServerHelper echoServer(9);
 
@@ -211,7 +535,19 @@ main(int argc, char* argv[])
         csma.EnablePcap("third", csmaDevices.Get(0), true);
     }
 
-    if (ascii)
+    std::vector<Ptr<BinaryTraceWriter>> binaryTraces;
+    if (ascii && binaryAscii)
+    {
+        // trace-expand needs the packet metadata to print the headers
+        Packet::EnablePrinting();
+        binaryTraces.push_back(Create<BinaryTraceWriter>("s3_wifi.trb"));
+        binaryTraces.back()->EnableWifiAll();
+        binaryTraces.push_back(Create<BinaryTraceWriter>("s3_csma.trb"));
+        binaryTraces.back()->EnableCsmaAll();
+        binaryTraces.push_back(Create<BinaryTraceWriter>("s3_p2p.trb"));
+        binaryTraces.back()->EnablePointToPointAll();
+    }
+    else if (ascii)
     {
         AsciiTraceHelper asciiHelper;
         phy.EnableAsciiAll(asciiHelper.CreateFileStream("s3_wifi.tr"));
@@ -219,8 +555,23 @@ main(int argc, char* argv[])
         pointToPoint.EnableAsciiAll(asciiHelper.CreateFileStream("s3_p2p.tr"));
     }
 
-    AnimationInterface animation("Wifi3.xml");
+    std::unique_ptr<AnimationInterface> animation;
+    if (animationEnabled)
+    {
+        animation = std::make_unique<AnimationInterface>("Wifi3.xml");
+        animation->SetMaxPktsPerTraceFile(animMaxPktsPerFile);
+        NS_ABORT_MSG_IF(!animPollInterval.IsStrictlyPositive(), "animPollInterval must be positive");
+        animation->SetMobilityPollInterval(animPollInterval);
+        if (!animPackets)
+        {
+            animation->SkipPacketTracing();
+        }
+    }
     Simulator::Run();
+    for (Ptr<BinaryTraceWriter> trace : binaryTraces)
+    {
+        trace->Close();
+    }
     Simulator::Destroy();
     return 0;
 }
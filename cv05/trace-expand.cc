@@ -0,0 +1,118 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Expands a binary trace written by third --ascii --binaryAscii back into the text
+ * of the ascii traces, e.g.
+ *
+ *   ./ns3 run "trace-expand --input=s3_p2p.trb --output=s3_p2p.tr"
+ *
+ * It links the same modules as third, so the headers recorded in the packet
+ * metadata print exactly as they do in the ascii traces.
+ */
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "binary-trace.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("TraceExpand");
+
+int
+main(int argc, char* argv[])
+{
+    std::string input = "s3_wifi.trb";
+    std::string output = "";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "Binary trace to expand", input);
+    cmd.AddValue("output", "Text trace to write, standard output if empty", output);
+    cmd.Parse(argc, argv);
+
+    Packet::EnablePrinting();
+
+    std::ifstream in(input.c_str(), std::ios::binary);
+    char magic[sizeof(BINARY_TRACE_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, BINARY_TRACE_MAGIC, sizeof(magic)) != 0)
+    {
+        std::cerr << input << " is not a binary trace" << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output.c_str());
+        if (!file.is_open())
+        {
+            std::cerr << "Can't open " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output.empty() ? std::cout : file;
+
+    std::vector<std::string> strings;
+    std::vector<uint8_t> data;
+    BinaryTraceRecord r;
+    while (in.read(reinterpret_cast<char*>(&r), sizeof(r)))
+    {
+        data.resize(r.size);
+        if (r.size > 0 && !in.read(reinterpret_cast<char*>(data.data()), r.size))
+        {
+            std::cerr << input << " is truncated" << std::endl;
+            return 1;
+        }
+        if (r.kind == BinaryTraceRecord::CONTEXT)
+        {
+            strings.resize(std::max<size_t>(strings.size(), r.context + 1));
+            strings[r.context].assign(data.begin(), data.end());
+            continue;
+        }
+
+        Ptr<Packet> p = Create<Packet>(data.data(), r.size, true);
+        double now = NanoSeconds(r.time).GetSeconds();
+        const std::string& context = strings.at(r.context);
+        // the same output statements as the ascii sinks of AsciiTraceHelper and WifiPhyHelper
+        switch (r.kind)
+        {
+        case BinaryTraceRecord::WIFI_TX: {
+            WifiMacTrailer fcs;
+            p->RemoveTrailer(fcs);
+            out << "t " << now << " " << context << " " << strings.at(r.mode) << " " << *p << " "
+                << fcs << std::endl;
+            break;
+        }
+        case BinaryTraceRecord::WIFI_RX: {
+            WifiMacTrailer fcs;
+            p->RemoveTrailer(fcs);
+            out << "r " << now << " " << strings.at(r.mode) << " " << context << " " << *p << " "
+                << fcs << std::endl;
+            break;
+        }
+        default:
+            out << r.kind << " " << now << " " << context << " " << *p << std::endl;
+            break;
+        }
+    }
+    return 0;
+}
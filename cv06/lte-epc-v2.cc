@@ -30,6 +30,19 @@
 #include "ns3/lte-module.h"
 #include "ns3/netanim-module.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace ns3;
 
@@ -41,6 +54,509 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("lte-basic-epc");
 
+/**
+ * Sequential reader of pcap capture files that does not load the file into memory.
+ *
+ * Plain files are mmap'ed in windows of a few tens of MB which are remapped as the reader
+ * advances, so multi-GB captures only cost a window of address space. Files ending in .gz
+ * are read from a "gzip -dc" pipe instead. Both microsecond and nanosecond captures in
+ * either byte order are accepted.
+ */
+class PcapTraceReader
+{
+public:
+  struct Record
+  {
+    int64_t ns;         // capture timestamp
+    uint32_t origLen;   // length of the packet on the wire
+    uint32_t inclLen;   // captured bytes available in data
+    const uint8_t *data;
+  };
+
+  PcapTraceReader ();
+  ~PcapTraceReader ();
+
+  void Open (std::string filename);
+  // Returns false at the end of the capture; data stays valid until the next call.
+  bool Next (Record &record);
+  uint32_t GetLinkType (void) const;
+
+private:
+  const uint8_t *Get (uint64_t length);
+  uint32_t Field (const uint8_t *p) const;
+
+  static const uint64_t WINDOW = 64 << 20;
+
+  std::string m_filename;
+  int m_fd;
+  FILE *m_pipe;
+  pid_t m_gzip;
+  uint64_t m_fileSize;
+  uint64_t m_pos;          // offset of the next unread byte
+  uint8_t *m_map;
+  uint64_t m_mapOffset;
+  uint64_t m_mapLength;
+  std::vector<uint8_t> m_buffer; // bytes read from the pipe
+  bool m_swapped;
+  bool m_nanosecond;
+  uint32_t m_linkType;
+};
+
+PcapTraceReader::PcapTraceReader ()
+  : m_fd (-1),
+    m_pipe (0),
+    m_gzip (-1),
+    m_fileSize (0),
+    m_pos (0),
+    m_map (0),
+    m_mapOffset (0),
+    m_mapLength (0),
+    m_swapped (false),
+    m_nanosecond (false),
+    m_linkType (0)
+{
+}
+
+PcapTraceReader::~PcapTraceReader ()
+{
+  if (m_map != 0)
+    {
+      munmap (m_map, m_mapLength);
+    }
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+    }
+  if (m_pipe != 0)
+    {
+      fclose (m_pipe);
+      waitpid (m_gzip, 0, 0);
+    }
+}
+
+void
+PcapTraceReader::Open (std::string filename)
+{
+  m_filename = filename;
+  if (filename.size () > 3 && filename.compare (filename.size () - 3, 3, ".gz") == 0)
+    {
+      // gzip reads the already opened file on stdin, so no shell ever sees the file name
+      int in = open (filename.c_str (), O_RDONLY | O_CLOEXEC);
+      NS_ABORT_MSG_IF (in < 0, "Can't open " << filename);
+      int out[2];
+      NS_ABORT_MSG_IF (pipe2 (out, O_CLOEXEC) != 0, "Can't create a pipe for " << filename);
+      posix_spawn_file_actions_t actions;
+      posix_spawn_file_actions_init (&actions);
+      posix_spawn_file_actions_adddup2 (&actions, in, 0);
+      posix_spawn_file_actions_adddup2 (&actions, out[1], 1);
+      char *argv[] = {const_cast<char *> ("gzip"), const_cast<char *> ("-dc"), 0};
+      int error = posix_spawnp (&m_gzip, "gzip", &actions, 0, argv, environ);
+      posix_spawn_file_actions_destroy (&actions);
+      close (in);
+      close (out[1]);
+      NS_ABORT_MSG_IF (error != 0, "Can't start gzip for " << filename << ": " << std::strerror (error));
+      m_pipe = fdopen (out[0], "r");
+    }
+  else
+    {
+      m_fd = open (filename.c_str (), O_RDONLY);
+      NS_ABORT_MSG_IF (m_fd < 0, "Can't open " << filename);
+      struct stat st;
+      NS_ABORT_MSG_IF (fstat (m_fd, &st) != 0, "Can't stat " << filename);
+      m_fileSize = st.st_size;
+    }
+
+  const uint8_t *header = Get (24);
+  NS_ABORT_MSG_IF (header == 0, filename << " is too short for a pcap file");
+  uint32_t magic;
+  std::memcpy (&magic, header, 4);
+  switch (magic)
+    {
+    case 0xa1b2c3d4: break;
+    case 0xd4c3b2a1: m_swapped = true; break;
+    case 0xa1b23c4d: m_nanosecond = true; break;
+    case 0x4d3cb2a1: m_swapped = true; m_nanosecond = true; break;
+    default: NS_FATAL_ERROR (filename << " is not a pcap file (pcapng is not supported)");
+    }
+  m_linkType = Field (header + 20) & 0x0fffffff;
+}
+
+uint32_t
+PcapTraceReader::GetLinkType (void) const
+{
+  return m_linkType;
+}
+
+uint32_t
+PcapTraceReader::Field (const uint8_t *p) const
+{
+  uint32_t v;
+  std::memcpy (&v, p, 4);
+  return m_swapped ? __builtin_bswap32 (v) : v;
+}
+
+const uint8_t *
+PcapTraceReader::Get (uint64_t length)
+{
+  if (m_pipe != 0)
+    {
+      m_buffer.resize (length);
+      if (length > 0 && fread (m_buffer.data (), 1, length, m_pipe) != length)
+        {
+          return 0;
+        }
+      m_pos += length;
+      return m_buffer.data ();
+    }
+
+  if (m_pos + length > m_fileSize)
+    {
+      return 0;
+    }
+  if (m_map == 0 || m_pos < m_mapOffset || m_pos + length > m_mapOffset + m_mapLength)
+    {
+      if (m_map != 0)
+        {
+          munmap (m_map, m_mapLength);
+        }
+      static const uint64_t page = sysconf (_SC_PAGESIZE);
+      m_mapOffset = m_pos - m_pos % page;
+      m_mapLength = std::min (m_fileSize - m_mapOffset, std::max (WINDOW, m_pos - m_mapOffset + length));
+      void *map = mmap (0, m_mapLength, PROT_READ, MAP_PRIVATE, m_fd, m_mapOffset);
+      NS_ABORT_MSG_IF (map == MAP_FAILED, "Can't map " << m_filename);
+      m_map = static_cast<uint8_t *> (map);
+      madvise (m_map, m_mapLength, MADV_SEQUENTIAL);
+    }
+  const uint8_t *p = m_map + (m_pos - m_mapOffset);
+  m_pos += length;
+  return p;
+}
+
+bool
+PcapTraceReader::Next (Record &record)
+{
+  const uint8_t *header = Get (16);
+  if (header == 0)
+    {
+      return false;
+    }
+  int64_t sec = Field (header);
+  int64_t frac = Field (header + 4);
+  record.ns = sec * 1000000000 + (m_nanosecond ? frac : frac * 1000);
+  record.inclLen = Field (header + 8);
+  record.origLen = Field (header + 12);
+  record.data = Get (record.inclLen);
+  return record.data != 0;
+}
+
+/**
+ * Replays the IPv4 packets of a pcap capture as UDP load between the UEs and the remote host.
+ *
+ * Addresses of the capture inside the UE network are mapped round-robin onto the simulated
+ * UEs. A packet sent from such an address is sent uplink from its UE to the remote host, a
+ * packet sent to one downlink from the remote host; packets between two other addresses are
+ * mapped by their flow (five-tuple) and sent downlink. Every packet is replayed as a UDP datagram
+ * carrying as many bytes as the transport payload of the original one, at its capture time
+ * (relative to the first packet) multiplied by TimeScale. Only the next packet is read ahead,
+ * so the capture is consumed as the simulation advances.
+ */
+class PcapReplay : public Application
+{
+public:
+  static TypeId GetTypeId (void);
+  PcapReplay ();
+  virtual ~PcapReplay ();
+
+  void Setup (std::string filename, NodeContainer ues, Ipv4InterfaceContainer ueIfaces, Ipv4Address remoteHostAddr);
+  uint64_t GetReplayed (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct Flow
+  {
+    uint32_t ue;
+    bool uplink;
+  };
+
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+  void ScheduleNext (void);
+  void Send (void);
+  // Decodes the record at the link layer, false if it isn't an IPv4 packet
+  bool Decode (const PcapTraceReader::Record &record);
+  uint32_t MapAddress (uint32_t address);
+
+  std::string m_filename;
+  double m_timeScale;
+  uint16_t m_port;
+  Ipv4Address m_ueNet;
+  Ipv4Mask m_ueMask;
+
+  PcapTraceReader m_reader;
+  NodeContainer m_ues;
+  Ipv4InterfaceContainer m_ueIfaces;
+  Ipv4Address m_remoteHostAddr;
+  std::vector<Ptr<Socket> > m_ueSockets;
+  Ptr<Socket> m_socket;
+  std::unordered_map<uint32_t, uint32_t> m_ueOfAddress;
+  std::map<std::tuple<uint32_t, uint32_t, uint8_t, uint16_t, uint16_t>, uint32_t> m_ueOfFlow;
+  uint32_t m_nextUe;
+
+  int64_t m_firstNs;
+  Time m_start;
+  Flow m_pending;            // decoded packet waiting for its send time
+  uint32_t m_pendingSize;
+  uint64_t m_replayed;
+  EventId m_event;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (PcapReplay);
+
+TypeId
+PcapReplay::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PcapReplay")
+    .SetParent<Application> ()
+    .AddConstructor<PcapReplay> ()
+    .AddAttribute ("TimeScale", "Factor applied to the time since the first packet of the capture",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&PcapReplay::m_timeScale),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("Port", "Destination port of the replayed packets",
+                   UintegerValue (4000),
+                   MakeUintegerAccessor (&PcapReplay::m_port),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("UeNetwork", "Network of the UE addresses in the capture",
+                   Ipv4AddressValue ("7.0.0.0"),
+                   MakeIpv4AddressAccessor (&PcapReplay::m_ueNet),
+                   MakeIpv4AddressChecker ())
+    .AddAttribute ("UeMask", "Mask of the UE network in the capture",
+                   Ipv4MaskValue ("255.0.0.0"),
+                   MakeIpv4MaskAccessor (&PcapReplay::m_ueMask),
+                   MakeIpv4MaskChecker ())
+  ;
+  return tid;
+}
+
+PcapReplay::PcapReplay ()
+  : m_nextUe (0),
+    m_firstNs (-1),
+    m_pendingSize (0),
+    m_replayed (0)
+{
+}
+
+PcapReplay::~PcapReplay ()
+{
+}
+
+void
+PcapReplay::DoDispose (void)
+{
+  m_socket = 0;
+  m_ueSockets.clear ();
+  Application::DoDispose ();
+}
+
+void
+PcapReplay::Setup (std::string filename, NodeContainer ues, Ipv4InterfaceContainer ueIfaces, Ipv4Address remoteHostAddr)
+{
+  NS_ABORT_MSG_IF (ues.GetN () == 0, "Replaying a capture needs at least one UE");
+  m_filename = filename;
+  m_ues = ues;
+  m_ueIfaces = ueIfaces;
+  m_remoteHostAddr = remoteHostAddr;
+}
+
+uint64_t
+PcapReplay::GetReplayed (void) const
+{
+  return m_replayed;
+}
+
+void
+PcapReplay::StartApplication (void)
+{
+  m_reader.Open (m_filename);
+  m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+  m_socket->Bind ();
+  for (uint32_t u = 0; u < m_ues.GetN (); ++u)
+    {
+      Ptr<Socket> socket = Socket::CreateSocket (m_ues.Get (u), UdpSocketFactory::GetTypeId ());
+      socket->Bind ();
+      m_ueSockets.push_back (socket);
+    }
+  m_start = Simulator::Now ();
+  ScheduleNext ();
+}
+
+void
+PcapReplay::StopApplication (void)
+{
+  Simulator::Cancel (m_event);
+}
+
+uint32_t
+PcapReplay::MapAddress (uint32_t address)
+{
+  auto it = m_ueOfAddress.find (address);
+  if (it == m_ueOfAddress.end ())
+    {
+      it = m_ueOfAddress.emplace (address, m_nextUe++ % m_ues.GetN ()).first;
+    }
+  return it->second;
+}
+
+bool
+PcapReplay::Decode (const PcapTraceReader::Record &record)
+{
+  const uint8_t *p = record.data;
+  uint32_t n = record.inclLen;
+  uint16_t etherType = 0x0800;
+  switch (m_reader.GetLinkType ())
+    {
+    case 1: // Ethernet
+      if (n < 14)
+        {
+          return false;
+        }
+      etherType = (p[12] << 8) | p[13];
+      p += 14; n -= 14;
+      if (etherType == 0x8100 && n >= 4)
+        {
+          etherType = (p[2] << 8) | p[3];
+          p += 4; n -= 4;
+        }
+      break;
+    case 9: // PPP, as written by PointToPointNetDevice
+      if (n >= 4 && p[0] == 0xff && p[1] == 0x03)
+        {
+          p += 2; n -= 2;
+        }
+      if (n < 2)
+        {
+          return false;
+        }
+      etherType = ((p[0] << 8) | p[1]) == 0x0021 ? 0x0800 : 0;
+      p += 2; n -= 2;
+      break;
+    case 113: // Linux cooked capture
+      if (n < 16)
+        {
+          return false;
+        }
+      etherType = (p[14] << 8) | p[15];
+      p += 16; n -= 16;
+      break;
+    case 12: case 101: case 228: // raw IPv4
+      break;
+    default:
+      NS_FATAL_ERROR ("Unsupported link type " << m_reader.GetLinkType () << " in " << m_filename);
+    }
+  if (etherType != 0x0800 || n < 20 || (p[0] >> 4) != 4)
+    {
+      return false;
+    }
+
+  uint32_t ihl = (p[0] & 0x0f) * 4;
+  uint32_t totalLength = (p[2] << 8) | p[3];
+  bool firstFragment = (((p[6] & 0x1f) << 8) | p[7]) == 0;
+  uint8_t protocol = p[9];
+  uint32_t src = (p[12] << 24) | (p[13] << 16) | (p[14] << 8) | p[15];
+  uint32_t dst = (p[16] << 24) | (p[17] << 16) | (p[18] << 8) | p[19];
+  uint16_t srcPort = 0;
+  uint16_t dstPort = 0;
+  uint32_t transportHeader = 0;
+  if (firstFragment && protocol == 17 && n >= ihl + 8)
+    {
+      srcPort = (p[ihl] << 8) | p[ihl + 1];
+      dstPort = (p[ihl + 2] << 8) | p[ihl + 3];
+      transportHeader = 8;
+    }
+  else if (firstFragment && protocol == 6 && n >= ihl + 20)
+    {
+      srcPort = (p[ihl] << 8) | p[ihl + 1];
+      dstPort = (p[ihl + 2] << 8) | p[ihl + 3];
+      transportHeader = (p[ihl + 12] >> 4) * 4;
+    }
+  m_pendingSize = totalLength > ihl + transportHeader ? totalLength - ihl - transportHeader : 0;
+
+  uint32_t ueNet = m_ueNet.Get () & m_ueMask.Get ();
+  if ((src & m_ueMask.Get ()) == ueNet)
+    {
+      m_pending.ue = MapAddress (src);
+      m_pending.uplink = true;
+    }
+  else if ((dst & m_ueMask.Get ()) == ueNet)
+    {
+      m_pending.ue = MapAddress (dst);
+      m_pending.uplink = false;
+    }
+  else
+    {
+      auto key = std::make_tuple (src, dst, protocol, srcPort, dstPort);
+      auto it = m_ueOfFlow.find (key);
+      if (it == m_ueOfFlow.end ())
+        {
+          it = m_ueOfFlow.emplace (key, m_nextUe++ % m_ues.GetN ()).first;
+        }
+      m_pending.ue = it->second;
+      m_pending.uplink = false;
+    }
+  return true;
+}
+
+void
+PcapReplay::ScheduleNext (void)
+{
+  PcapTraceReader::Record record;
+  while (m_reader.Next (record))
+    {
+      if (!Decode (record))
+        {
+          continue;
+        }
+      if (m_firstNs < 0)
+        {
+          m_firstNs = record.ns;
+        }
+      Time at = m_start + NanoSeconds (static_cast<int64_t> ((record.ns - m_firstNs) * m_timeScale));
+      m_event = Simulator::Schedule (std::max (at - Simulator::Now (), Time (0)), &PcapReplay::Send, this);
+      return;
+    }
+  NS_LOG_INFO ("Replayed " << m_replayed << " packets of " << m_filename);
+}
+
+void
+PcapReplay::Send (void)
+{
+  if (m_pending.uplink)
+    {
+      m_ueSockets[m_pending.ue]->SendTo (Create<Packet> (m_pendingSize), 0,
+                                         InetSocketAddress (m_remoteHostAddr, m_port));
+    }
+  else
+    {
+      m_socket->SendTo (Create<Packet> (m_pendingSize), 0,
+                        InetSocketAddress (m_ueIfaces.GetAddress (m_pending.ue), m_port));
+    }
+  m_replayed++;
+  ScheduleNext ();
+}
+
+// Current default of a double attribute, including the changes made by Config::SetDefault and the command line
+static double
+GetDoubleDefault (std::string typeName, std::string attribute)
+{
+  TypeId::AttributeInformation info;
+  NS_ABORT_MSG_UNLESS (TypeId::LookupByName (typeName).LookupAttributeByName (attribute, &info),
+                       "No attribute " << attribute << " in " << typeName);
+  return DynamicCast<const DoubleValue> (info.initialValue)->Get ();
+}
+
+
 int
 main (int argc, char *argv[])
 {
@@ -51,6 +567,15 @@ main (int argc, char *argv[])
   bool disableDl = false;
   bool disableUl = false;
   bool disablePl = false;
+  std::string replayPcap = "";
+  double replayTimeScale = 1.0;
+  uint16_t replayPort = 4000;
+  double maxLossDb = 0.0;
+  double prunedNoiseDb = 0.0;
+  bool animation = true;
+  bool animPackets = true;
+  uint64_t animMaxPktsPerFile = 100000;
+  Time animPollInterval = Seconds (0.25);
 
   // Command line arguments
   CommandLine cmd;
@@ -61,6 +586,15 @@ main (int argc, char *argv[])
   cmd.AddValue ("disableDl", "Disable downlink data flows", disableDl);
   cmd.AddValue ("disableUl", "Disable uplink data flows", disableUl);
   cmd.AddValue ("disablePl", "Disable data flows between peer UEs", disablePl);
+  cmd.AddValue ("animation", "Write the NetAnim trace", animation);
+  cmd.AddValue ("animPackets", "animation: include the packet events, otherwise only nodes and positions", animPackets);
+  cmd.AddValue ("animMaxPktsPerFile", "animation: packets per trace file before the next file is started", animMaxPktsPerFile);
+  cmd.AddValue ("animPollInterval", "animation: interval between two position samples of the mobile nodes", animPollInterval);
+  cmd.AddValue ("replayPcap", "Capture (.pcap or .pcap.gz) whose IPv4 packets are replayed as load between the UEs and the remote host", replayPcap);
+  cmd.AddValue ("replayTimeScale", "Factor applied to the timing of the replayed capture", replayTimeScale);
+  cmd.AddValue ("replayPort", "Port of the sinks receiving the replayed packets", replayPort);
+  cmd.AddValue ("maxLossDb", "Path loss above which a PHY gets no copy of a transmission, so its interference is not computed at all (0 disables the cutoff)", maxLossDb);
+  cmd.AddValue ("prunedNoiseDb", "Added to the noise figure of the eNBs and UEs to account for the interference removed by maxLossDb", prunedNoiseDb);
   cmd.Parse (argc, argv);
 
   // ConfigStore inputConfig;
@@ -73,6 +607,19 @@ main (int argc, char *argv[])
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper> (); // create LteHelper object
   Ptr<PointToPointEpcHelper> epcHelper = CreateObject<PointToPointEpcHelper> (); // PointToPointEpcHelper
   lteHelper->SetEpcHelper (epcHelper); // enable the use of EPC by LTE helper
+  if (maxLossDb > 0)
+    {
+      // the spectrum channel drops the receivers beyond the cutoff before scheduling StartRx
+      lteHelper->SetSpectrumChannelAttribute ("MaxLossDb", DoubleValue (maxLossDb));
+    }
+  if (prunedNoiseDb > 0)
+    {
+      // the pruned far cells become a constant noise rise on top of the configured noise figures
+      double enbNoiseFigure = GetDoubleDefault ("ns3::LteEnbPhy", "NoiseFigure");
+      double ueNoiseFigure = GetDoubleDefault ("ns3::LteUePhy", "NoiseFigure");
+      Config::SetDefault ("ns3::LteEnbPhy::NoiseFigure", DoubleValue (enbNoiseFigure + prunedNoiseDb));
+      Config::SetDefault ("ns3::LteUePhy::NoiseFigure", DoubleValue (ueNoiseFigure + prunedNoiseDb));
+    }
 
   Ptr<Node> pgw = epcHelper->GetPgwNode (); // get the PGW node
 
@@ -118,7 +665,7 @@ main (int argc, char *argv[])
 
   mobility.SetMobilityModel("ns3::RandomDirection2dMobilityModel",
                             "Pause", StringValue ("ns3::ConstantRandomVariable[Constant=0.005]"),
-                            "Bounds", RectangleValue(Rectangle(-10, 70, -25, 25)),
+                            "Bounds", RectangleValue(Rectangle(-10, distance * (numNodePairs - 1) + 10, -25, 25)),
                             "Speed", StringValue("ns3::UniformRandomVariable[Min=20.0|Max=40.0]")); // mobility model (constant)
   mobility.SetPositionAllocator(positionAllocUe);
   mobility.Install(ueNodes);
@@ -195,6 +742,20 @@ main (int argc, char *argv[])
         }
     }
 
+  if (!replayPcap.empty ())
+    {
+      PacketSinkHelper replaySinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), replayPort));
+      serverApps.Add (replaySinkHelper.Install (ueNodes));
+      serverApps.Add (replaySinkHelper.Install (remoteHost));
+
+      Ptr<PcapReplay> replay = CreateObject<PcapReplay> ();
+      replay->SetAttribute ("TimeScale", DoubleValue (replayTimeScale));
+      replay->SetAttribute ("Port", UintegerValue (replayPort));
+      replay->Setup (replayPcap, ueNodes, ueIpIface, remoteHostAddr);
+      remoteHost->AddApplication (replay);
+      clientApps.Add (replay);
+    }
+
   serverApps.Start (MilliSeconds (500));
   clientApps.Start (MilliSeconds (500));
   // lteHelper->EnableTraces ();
@@ -204,20 +765,31 @@ main (int argc, char *argv[])
 
   Simulator::Stop (simTime);
 
-  AnimationInterface animation("cv06.xml");
-  animation.UpdateNodeDescription(pgw,"PGW");
-  animation.UpdateNodeDescription(remoteHost, "Remote_Host");
-
-  for (uint32_t u = 0; u < ueNodes.GetN(); ++u)
-  {
-    animation.UpdateNodeDescription(ueNodes.Get(u), "Ue_" + std::to_string(u));
-    animation.UpdateNodeColor(ueNodes.Get(u), 0, 0, 255);
-  }
-  for (uint32_t u = 0; u < enbNodes.GetN(); ++u)
-  {
-    animation.UpdateNodeDescription(enbNodes.Get(u), "eNodeB_" + std::to_string(u));
-    animation.UpdateNodeColor(enbNodes.Get(u), 0, 255, 0);
-  }
+  std::unique_ptr<AnimationInterface> anim;
+  if (animation)
+    {
+      anim.reset (new AnimationInterface ("cv06.xml"));
+      anim->SetMaxPktsPerTraceFile (animMaxPktsPerFile);
+      NS_ABORT_MSG_IF (!animPollInterval.IsStrictlyPositive (), "animPollInterval must be positive");
+      anim->SetMobilityPollInterval (animPollInterval);
+      if (!animPackets)
+        {
+          anim->SkipPacketTracing ();
+        }
+      anim->UpdateNodeDescription(pgw,"PGW");
+      anim->UpdateNodeDescription(remoteHost, "Remote_Host");
+
+      for (uint32_t u = 0; u < ueNodes.GetN(); ++u)
+      {
+        anim->UpdateNodeDescription(ueNodes.Get(u), "Ue_" + std::to_string(u));
+        anim->UpdateNodeColor(ueNodes.Get(u), 0, 0, 255);
+      }
+      for (uint32_t u = 0; u < enbNodes.GetN(); ++u)
+      {
+        anim->UpdateNodeDescription(enbNodes.Get(u), "eNodeB_" + std::to_string(u));
+        anim->UpdateNodeColor(enbNodes.Get(u), 0, 255, 0);
+      }
+    }
   
 
   Simulator::Run ();
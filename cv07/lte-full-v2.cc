@@ -20,6 +20,7 @@
 */
 
 #include <fstream>
+#include <memory>
 #include <string>
 
 #include "ns3/lte-helper.h"
@@ -40,6 +41,7 @@
 #include "ns3/traffic-control-module.h"
 #include "ns3/data-rate.h"
 #include "ns3/gnuplot.h"
+#include "rotating-pcap-sink.h"
 
 using namespace ns3;
 
@@ -54,6 +56,15 @@ int main(int argc, char *argv[]) {
   double distance = 200.0;
   bool useCa = true;
   Time interPacketInterval = MilliSeconds (200);
+  bool errorModels = true;
+  std::string scheduler = "ns3::PfFfMacScheduler"; // LteHelper default
+  bool rotatingPcap = false;
+  RotatingPcapSink::Options pcapOptions;
+  uint32_t pcapMaxFileMb = 0;
+  bool animation = true;
+  bool animPackets = true;
+  uint64_t animMaxPktsPerFile = 100000;
+  Time animPollInterval = Seconds (0.75);
 
   // Command line arguments
   CommandLine cmd;
@@ -63,6 +74,18 @@ int main(int argc, char *argv[]) {
   cmd.AddValue("useCa", "Whether to use carrier aggregation.", useCa);
   cmd.AddValue("interval", "Inter-packet interval for UDP client [ms]", interval);
   cmd.AddValue ("interPacketInterval", "Inter packet interval", interPacketInterval);
+  cmd.AddValue ("errorModels", "Evaluate the LTE MI error model for every control and data block (default). false is a fidelity trade-off: every block is received correctly whatever its SINR, so BLER, HARQ retransmissions and throughput at the cell edge are no longer modelled, as in nb-iot-v2", errorModels);
+  cmd.AddValue ("scheduler", "Type of the eNB MAC scheduler. Another policy changes the resource allocation and thus the results, not only the cost: e.g. ns3::RrFfMacScheduler keeps no per-UE metrics and is cheaper for large UE counts, but shares the RBs round robin without regard to the channel quality", scheduler);
+  cmd.AddValue ("animation", "Write the NetAnim trace", animation);
+  cmd.AddValue ("animPackets", "animation: include the packet events, otherwise only nodes and positions", animPackets);
+  cmd.AddValue ("animMaxPktsPerFile", "animation: packets per trace file before the next file is started", animMaxPktsPerFile);
+  cmd.AddValue ("animPollInterval", "animation: interval between two position samples of the mobile nodes", animPollInterval);
+  cmd.AddValue ("rotatingPcap", "Capture the point-to-point links with RotatingPcapSink instead of full EnablePcapAll traces", rotatingPcap);
+  cmd.AddValue ("pcapSnapLen", "rotatingPcap: bytes kept of every packet, 0 keeps them whole", pcapOptions.snapLen);
+  cmd.AddValue ("pcapMaxFileMb", "rotatingPcap: start a new capture file after this many MB, 0 never", pcapMaxFileMb);
+  cmd.AddValue ("pcapMaxFileTime", "rotatingPcap: start a new capture file after this much simulation time, 0 never", pcapOptions.maxFileTime);
+  cmd.AddValue ("pcapCompress", "rotatingPcap: gzip the capture files", pcapOptions.compress);
+  cmd.AddValue ("pcapFilter", "rotatingPcap: keep only matching packets, e.g. src=7.0.0.2,proto=17,dport=2001", pcapOptions.filter);
   cmd.Parse(argc, argv);
 
   if (useCa) {
@@ -70,6 +93,11 @@ int main(int argc, char *argv[]) {
       Config::SetDefault("ns3::LteHelper::NumberOfComponentCarriers", UintegerValue(2));
       Config::SetDefault("ns3::LteHelper::EnbComponentCarrierManager", StringValue("ns3::RrComponentCarrierManager"));
   }
+  if (!errorModels) {
+      // faster, but no block is ever lost; only for runs that don't depend on the radio link quality
+      Config::SetDefault ("ns3::LteSpectrumPhy::CtrlErrorModelEnabled", BooleanValue (false));
+      Config::SetDefault ("ns3::LteSpectrumPhy::DataErrorModelEnabled", BooleanValue (false));
+  }
 
   ConfigStore inputConfig;
   inputConfig.ConfigureDefaults();
@@ -80,6 +108,11 @@ int main(int argc, char *argv[]) {
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper> (); // create LteHelper object
   Ptr<PointToPointEpcHelper>  epcHelper = CreateObject<PointToPointEpcHelper> (); // PointToPointEpcHelper
   lteHelper->SetEpcHelper (epcHelper); // enable the use of EPC by LTE helper
+  // An incremental PF scheduler could be registered from this script as an FfMacScheduler subclass,
+  // but it would have to reimplement the whole CSCHED/SCHED SAP of PfFfMacScheduler (HARQ, RACH,
+  // CQI and BSR handling, DCI building), whose per-TTI allocation is private and can't be overridden
+  // alone. Until such a scheduler is written and validated against PF, only existing types are offered.
+  lteHelper->SetSchedulerType (scheduler);
 
   lteHelper->SetEnbDeviceAttribute("DlBandwidth", UintegerValue(100));
   lteHelper->SetEnbDeviceAttribute("UlBandwidth", UintegerValue(100));
@@ -222,38 +255,51 @@ int main(int argc, char *argv[]) {
   // Uncomment to enable traces
   // lteHelper->EnableTraces();
 
-  // Animation definition
-  AnimationInterface anim("lte-full.xml");
-  
-
-  /// Optional step
-  anim.SetMobilityPollInterval (Seconds (0.75));
-  
-  // Uncomment to enable recording of packet Metadata
-  // anim.EnablePacketMetadata(true);
-
-  unsigned long long maxAnimPackets = 0xFFFFFFFFFFFFFFFF;
-  anim.SetMaxPktsPerTraceFile(maxAnimPackets);
-  
-  anim.UpdateNodeDescription(pgw, "PGW");
-  anim.UpdateNodeDescription(remoteHost, "RemoteHost");
-  anim.UpdateNodeDescription(1, "SGW");
-  anim.UpdateNodeDescription(2, "MME");
-
-  for (uint32_t u = 0; u < ueNodes.GetN(); ++u)
+  // Animation definition, split into files of animMaxPktsPerFile packets
+  std::unique_ptr<AnimationInterface> anim;
+  if (animation)
     {
-      anim.UpdateNodeDescription(ueNodes.Get(u), "Ue_" + std::to_string(u));
-      anim.UpdateNodeColor(ueNodes.Get(u), 0, 0, 255); // Optional
-   }
-
-  for (uint32_t u = 0; u < enbNodes.GetN(); ++u)
-    {
-      anim.UpdateNodeDescription(enbNodes.Get(u), "eNodeB_" + std::to_string(u));
-      anim.UpdateNodeColor(enbNodes.Get(u), 0, 255, 0); // Optional
+      anim.reset (new AnimationInterface ("lte-full.xml"));
+      anim->SetMaxPktsPerTraceFile (animMaxPktsPerFile);
+      NS_ABORT_MSG_IF (!animPollInterval.IsStrictlyPositive (), "animPollInterval must be positive");
+      anim->SetMobilityPollInterval (animPollInterval);
+      if (!animPackets)
+        {
+          anim->SkipPacketTracing ();
+        }
+
+      // Uncomment to enable recording of packet Metadata
+      // anim->EnablePacketMetadata(true);
+
+      anim->UpdateNodeDescription(pgw, "PGW");
+      anim->UpdateNodeDescription(remoteHost, "RemoteHost");
+      anim->UpdateNodeDescription(1, "SGW");
+      anim->UpdateNodeDescription(2, "MME");
+
+      for (uint32_t u = 0; u < ueNodes.GetN(); ++u)
+        {
+          anim->UpdateNodeDescription(ueNodes.Get(u), "Ue_" + std::to_string(u));
+          anim->UpdateNodeColor(ueNodes.Get(u), 0, 0, 255); // Optional
+        }
+
+      for (uint32_t u = 0; u < enbNodes.GetN(); ++u)
+        {
+          anim->UpdateNodeDescription(enbNodes.Get(u), "eNodeB_" + std::to_string(u));
+          anim->UpdateNodeColor(enbNodes.Get(u), 0, 255, 0); // Optional
+        }
     }
 
   // Uncomment to enable PCAP tracing
-  p2ph.EnablePcapAll("lte-full");
+  std::vector<Ptr<RotatingPcapSink> > pcapSinks;
+  if (rotatingPcap)
+    {
+      pcapOptions.maxFileBytes = uint64_t (pcapMaxFileMb) << 20;
+      pcapSinks = EnableRotatingPcapAll ("lte-full", pcapOptions);
+    }
+  else
+    {
+      p2ph.EnablePcapAll("lte-full");
+    }
 
   Ptr <FlowMonitor> monitor; // = flowMonHelper.InstallAll();
   FlowMonitorHelper flowMonHelper;
@@ -263,6 +309,10 @@ int main(int argc, char *argv[]) {
 
   Simulator::Stop(Seconds(simTime));
   Simulator::Run();
+  for (Ptr<RotatingPcapSink> sink : pcapSinks)
+    {
+      sink->Close ();
+    }
 
   // GnuPlot
   std::string jmenoSouboru = "delay";
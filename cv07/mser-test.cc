@@ -0,0 +1,94 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Checks of the MSER-5 truncation used by nb-iot-v2 --autoWarmup on synthetic series.
+ * It is not part of the ns-3 build and does not link against ns-3; build and run it
+ * from this directory with
+ *
+ *   g++ -O2 -std=c++17 -o mser-test mser-test.cc && ./mser-test
+ *
+ * It exits with a non-zero status if a check fails.
+ */
+
+#include "mser.h"
+
+#include <cmath>
+#include <iostream>
+#include <string>
+
+using namespace ns3;
+
+static int g_failed = 0;
+
+static void
+Check (bool ok, std::string what)
+{
+  std::cout << (ok ? "PASS " : "FAIL ") << what << std::endl;
+  if (!ok)
+    {
+      g_failed++;
+    }
+}
+
+// deterministic noise in [-1, 1)
+static double
+Noise (uint32_t i)
+{
+  uint32_t x = i * 2654435761u + 12345;
+  x ^= x >> 13;
+  x *= 0x5bd1e995;
+  x ^= x >> 15;
+  return (x % 2000) / 1000.0 - 1;
+}
+
+int
+main ()
+{
+  std::vector<double> ramp;
+  for (uint32_t i = 0; i < 200; ++i)
+    {
+      ramp.push_back (i);
+    }
+  Check (Mser5 (ramp) < 0, "a monotonically ramping series is rejected");
+
+  std::vector<double> noisyRamp;
+  for (uint32_t i = 0; i < 200; ++i)
+    {
+      noisyRamp.push_back (0.1 * i + Noise (i));
+    }
+  Check (Mser5 (noisyRamp) < 0, "a noisy ramp is rejected");
+
+  std::vector<double> stationary;
+  for (uint32_t i = 0; i < 200; ++i)
+    {
+      stationary.push_back (10 + Noise (i));
+    }
+  Check (Mser5 (stationary) >= 0, "a stationary series is accepted");
+
+  std::vector<double> warmup;
+  for (uint32_t i = 0; i < 200; ++i)
+    {
+      warmup.push_back (10 * (1 - std::exp (-(i / 10.0))) + Noise (i));
+    }
+  int64_t truncation = Mser5 (warmup);
+  Check (truncation >= 10 && truncation < 100, "the transient of a warm-up series is truncated");
+
+  std::vector<double> shortSeries (stationary.begin (), stationary.begin () + 5 * (2 * MSER_MIN_TAIL - 1));
+  Check (Mser5 (shortSeries) < 0, "a series with too few batches is rejected");
+
+  return g_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MSER_H
+#define MSER_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ns3 {
+
+// minimum number of batches after the truncation point, see Mser5
+static const uint32_t MSER_MIN_TAIL = 5;
+
+/**
+ * MSER-5 truncation point of a series, used by the steady-state detection of nb-iot-v2.
+ *
+ * The samples are grouped into batch means of 5, and MSER(d) = sum_{j>=d} (y_j - mean_d)^2 / (k - d)^2
+ * is minimized over every truncation d that leaves at least MSER_MIN_TAIL batches, the statistic
+ * being meaningless on shorter tails. The series is only considered steady if this global minimum
+ * lies in the first half of the batches; a series that is still drifting has its minimum near the
+ * end. Returns the truncation point in samples, or -1 if the series is not (yet) steady or has
+ * fewer than 2 * MSER_MIN_TAIL batches.
+ */
+inline int64_t
+Mser5 (const std::vector<double> &samples)
+{
+  std::vector<double> y;
+  for (uint32_t i = 0; i + 5 <= samples.size (); i += 5)
+    {
+      y.push_back ((samples[i] + samples[i+1] + samples[i+2] + samples[i+3] + samples[i+4]) / 5);
+    }
+  uint32_t k = y.size ();
+  if (k < 2 * MSER_MIN_TAIL)
+    {
+      return -1;
+    }
+  // evaluated from the back with running sums
+  double sum = 0;
+  double sumSq = 0;
+  double best = std::numeric_limits<double>::max ();
+  uint32_t bestD = k;
+  for (uint32_t d = k; d-- > 0; )
+    {
+      sum += y[d];
+      sumSq += y[d] * y[d];
+      double n = k - d;
+      double mser = (sumSq - sum * sum / n) / (n * n);
+      if (n >= MSER_MIN_TAIL && mser <= best)
+        {
+          best = mser;
+          bestD = d;
+        }
+    }
+  return bestD < k / 2 ? int64_t (bestD) * 5 : -1;
+}
+
+} // namespace ns3
+
+#endif /* MSER_H */
@@ -0,0 +1,542 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Campaign driver for nb-iot-v2. It expands a seed range and a parameter grid
+ * into single runs and executes them as separate processes, one per core.
+ *
+ * Every run gets its own working directory (the scenario writes its pcap,
+ * animation and flowmon files relative to the cwd) and is pinned to one core,
+ * whose number is passed on as --worker. A new run is only started when
+ * /proc/meminfo reports enough available memory for it on top of what the runs
+ * still going are expected to allocate beyond their current RSS; the per-run
+ * estimate starts at --memPerRunMb and is raised to the largest peak RSS
+ * observed so far.
+ * When all runs are finished, the per-UE statistics of the evaluated window
+ * written through --statsFile are merged into flows.csv and summary.csv in --outDir.
+ *
+ * This is a plain POSIX program, it does not link against ns-3:
+ *
+ * \code{.unparsed}
+$ g++ -O2 -std=c++17 -o nb-iot-campaign nb-iot-campaign.cc
+$ ./nb-iot-campaign --program=build/scratch/ns3-dev-nb-iot-v2-default \
+      --seeds=1:30 --numUeAppA=1,5 --ciot=0,1 --edt=0,1 --simTime=2min
+    \endcode
+ */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Run
+{
+  uint32_t id;
+  uint32_t config;                 // index into the parameter grid
+  int seed;
+  std::vector<std::string> params; // --name=value pairs of the grid point
+  std::string dir;
+};
+
+struct Running
+{
+  uint32_t run;
+  int core;
+};
+
+// Parameters of nb-iot-v2 that can be swept; each takes a comma separated list.
+const char *g_gridParams[] = {"numUeAppA", "numUeAppB", "numUeAppC", "ciot", "edt", "simTime"};
+
+std::vector<std::string>
+Split (const std::string &s, char sep)
+{
+  std::vector<std::string> out;
+  std::stringstream ss (s);
+  std::string item;
+  while (std::getline (ss, item, sep))
+    {
+      if (!item.empty ())
+        {
+          out.push_back (item);
+        }
+    }
+  return out;
+}
+
+// MemAvailable in kB, or 0 if the kernel does not report it.
+uint64_t
+GetAvailableMemoryKb ()
+{
+  std::ifstream meminfo ("/proc/meminfo");
+  std::string key;
+  uint64_t value;
+  std::string unit;
+  while (meminfo >> key >> value >> unit)
+    {
+      if (key == "MemAvailable:")
+        {
+          return value;
+        }
+    }
+  return 0;
+}
+
+// VmRSS of a running process in kB, or 0 if it can't be read.
+uint64_t
+GetRssKb (pid_t pid)
+{
+  std::ifstream status (("/proc/" + std::to_string (pid) + "/status").c_str ());
+  std::string line;
+  while (std::getline (status, line))
+    {
+      if (line.compare (0, 6, "VmRSS:") == 0)
+        {
+          return std::strtoull (line.c_str () + 6, nullptr, 10);
+        }
+    }
+  return 0;
+}
+
+// Parses the value of a numeric option, printing the error for the user on failure.
+bool
+ParseNumber (const std::string &name, const std::string &value, uint64_t &number)
+{
+  // stoull accepts a sign and trailing garbage, so check the characters first
+  if (!value.empty () && value.find_first_not_of ("0123456789") == std::string::npos)
+    {
+      try
+        {
+          number = std::stoull (value);
+          return true;
+        }
+      catch (const std::out_of_range &)
+        {
+        }
+    }
+  std::cerr << "Invalid --" << name << "=" << value << ", expected a non-negative integer" << std::endl;
+  return false;
+}
+
+bool
+MakeDir (const std::string &dir)
+{
+  std::string path;
+  for (const std::string &part : Split (dir, '/'))
+    {
+      path += (path.empty () && dir[0] != '/') ? part : "/" + part;
+      if (mkdir (path.c_str (), 0755) != 0 && errno != EEXIST)
+        {
+          std::cerr << "Can't create directory " << path << ": " << strerror (errno) << std::endl;
+          return false;
+        }
+    }
+  return true;
+}
+
+pid_t
+Launch (const std::string &program, const Run &run, int core, const std::string &simName)
+{
+  std::vector<std::string> args;
+  args.push_back (program);
+  args.push_back ("--simName=" + simName);
+  args.push_back ("--worker=" + std::to_string (core));
+  args.push_back ("--randomSeed=" + std::to_string (run.seed));
+  args.push_back ("--statsFile=flowstats.csv");
+  // The windowed statistics are all the campaign needs; skip the full FlowMonitor.
+  args.push_back ("--flowMonitor=false");
+  args.insert (args.end (), run.params.begin (), run.params.end ());
+
+  pid_t pid = fork ();
+  if (pid != 0)
+    {
+      return pid;
+    }
+
+  // child
+  cpu_set_t mask;
+  CPU_ZERO (&mask);
+  CPU_SET (core, &mask);
+  if (sched_setaffinity (0, sizeof (mask), &mask) != 0)
+    {
+      std::cerr << "run " << run.id << ": can't pin to core " << core << std::endl;
+    }
+  if (chdir (run.dir.c_str ()) != 0)
+    {
+      _exit (127);
+    }
+  int out = open ("stdout.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out >= 0)
+    {
+      dup2 (out, STDOUT_FILENO);
+      dup2 (out, STDERR_FILENO);
+      close (out);
+    }
+  std::vector<char *> argv;
+  for (std::string &a : args)
+    {
+      argv.push_back (&a[0]);
+    }
+  argv.push_back (nullptr);
+  execv (argv[0], argv.data ());
+  _exit (127);
+}
+
+struct FlowTotals
+{
+  uint32_t seeds = 0;
+  uint64_t flows = 0;
+  uint64_t txPackets = 0;
+  uint64_t rxPackets = 0;
+  uint64_t rxBytes = 0;
+  double delaySum = 0;
+  double jitterSum = 0;
+  uint64_t echoRxPackets = 0;
+  double rttSum = 0;
+};
+
+// Appends the flows of one run to flows.csv and accumulates them into totals.
+bool
+MergeRun (const Run &run, std::ofstream &flows, FlowTotals &totals)
+{
+  std::ifstream in ((run.dir + "/flowstats.csv").c_str ());
+  if (!in.is_open ())
+    {
+      return false;
+    }
+  std::string line;
+  std::getline (in, line); // header
+  while (std::getline (in, line))
+    {
+      std::vector<std::string> f = Split (line, ',');
+      if (f.size () < 13)
+        {
+          continue;
+        }
+      flows << run.config << "," << line << "\n";
+      totals.flows++;
+      totals.txPackets += std::stoull (f[4]);
+      totals.rxPackets += std::stoull (f[5]);
+      totals.rxBytes += std::stoull (f[7]);
+      totals.delaySum += std::stod (f[8]);
+      totals.jitterSum += std::stod (f[9]);
+      totals.rttSum += std::stod (f[12]);
+      totals.echoRxPackets += std::stoull (f[10]);
+    }
+  totals.seeds++;
+  return true;
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::string program;
+  std::string seeds = "1:1";
+  std::string outDir = "campaign";
+  std::string simName = "campaign";
+  uint32_t jobs = 0;
+  uint64_t memPerRunMb = 512;
+  std::map<std::string, std::vector<std::string>> grid;
+
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      size_t eq = arg.find ('=');
+      if (arg.compare (0, 2, "--") != 0 || eq == std::string::npos)
+        {
+          std::cerr << "Unknown argument " << arg << std::endl;
+          return 1;
+        }
+      std::string name = arg.substr (2, eq - 2);
+      std::string value = arg.substr (eq + 1);
+      if (name == "program")
+        {
+          program = value;
+        }
+      else if (name == "seeds")
+        {
+          seeds = value;
+        }
+      else if (name == "outDir")
+        {
+          outDir = value;
+        }
+      else if (name == "simName")
+        {
+          simName = value;
+        }
+      else if (name == "jobs")
+        {
+          uint64_t n;
+          if (!ParseNumber (name, value, n))
+            {
+              return 1;
+            }
+          if (n == 0 || n > UINT32_MAX)
+            {
+              std::cerr << "Invalid --jobs=" << value << ", leave it out to use all cores" << std::endl;
+              return 1;
+            }
+          jobs = n;
+        }
+      else if (name == "memPerRunMb")
+        {
+          if (!ParseNumber (name, value, memPerRunMb))
+            {
+              return 1;
+            }
+        }
+      else if (std::find_if (std::begin (g_gridParams), std::end (g_gridParams),
+                             [&name] (const char *p) { return name == p; }) != std::end (g_gridParams))
+        {
+          grid[name] = Split (value, ',');
+        }
+      else
+        {
+          std::cerr << "Unknown argument " << arg << std::endl;
+          return 1;
+        }
+    }
+
+  if (program.empty ())
+    {
+      std::cerr << "Usage: " << argv[0] << " --program=<nb-iot-v2 binary> [--seeds=first:last]"
+                << " [--jobs=N] [--memPerRunMb=MB] [--outDir=dir] [--simName=name]"
+                << " [--numUeAppA=a,b,..] [--numUeAppB=..] [--numUeAppC=..] [--ciot=..]"
+                << " [--edt=..] [--simTime=..]" << std::endl;
+      return 1;
+    }
+  char *resolved = realpath (program.c_str (), nullptr);
+  if (resolved == nullptr)
+    {
+      std::cerr << "Can't find program " << program << std::endl;
+      return 1;
+    }
+  program = resolved;
+  free (resolved);
+
+  int firstSeed = 1;
+  int lastSeed = 1;
+  std::vector<std::string> range = Split (seeds, ':');
+  try
+    {
+      firstSeed = std::stoi (range.at (0));
+      lastSeed = range.size () > 1 ? std::stoi (range[1]) : firstSeed;
+    }
+  catch (const std::invalid_argument &)
+    {
+      std::cerr << "Invalid --seeds=" << seeds << ", expected first[:last]" << std::endl;
+      return 1;
+    }
+  catch (const std::out_of_range &)
+    {
+      std::cerr << "Invalid --seeds=" << seeds << ", expected first[:last]" << std::endl;
+      return 1;
+    }
+  if (lastSeed < firstSeed)
+    {
+      std::cerr << "Invalid --seeds=" << seeds << ", last is smaller than first" << std::endl;
+      return 1;
+    }
+
+  // Cores this process may use; each run is pinned to one of them.
+  cpu_set_t allowed;
+  CPU_ZERO (&allowed);
+  sched_getaffinity (0, sizeof (allowed), &allowed);
+  std::vector<int> freeCores;
+  for (int c = CPU_SETSIZE - 1; c >= 0; --c)
+    {
+      if (CPU_ISSET (c, &allowed))
+        {
+          freeCores.push_back (c);
+        }
+    }
+  if (jobs == 0 || jobs > freeCores.size ())
+    {
+      jobs = freeCores.size ();
+    }
+  freeCores.erase (freeCores.begin (), freeCores.end () - jobs);
+
+  // Expand the grid: every combination of the given values, times every seed.
+  std::vector<std::vector<std::string>> configs (1);
+  for (const auto &param : grid)
+    {
+      std::vector<std::vector<std::string>> expanded;
+      for (const auto &config : configs)
+        {
+          for (const std::string &value : param.second)
+            {
+              expanded.push_back (config);
+              expanded.back ().push_back ("--" + param.first + "=" + value);
+            }
+        }
+      configs.swap (expanded);
+    }
+
+  if (!MakeDir (outDir))
+    {
+      return 1;
+    }
+  std::vector<Run> runs;
+  for (uint32_t c = 0; c < configs.size (); ++c)
+    {
+      for (int seed = firstSeed; seed <= lastSeed; ++seed)
+        {
+          Run run;
+          run.id = runs.size ();
+          run.config = c;
+          run.seed = seed;
+          run.params = configs[c];
+          run.dir = outDir + "/run_" + std::to_string (run.id);
+          if (!MakeDir (run.dir))
+            {
+              return 1;
+            }
+          runs.push_back (run);
+        }
+    }
+
+  std::cout << runs.size () << " runs (" << configs.size () << " configurations x "
+            << lastSeed - firstSeed + 1 << " seeds) on up to " << jobs << " cores" << std::endl;
+
+  std::map<pid_t, Running> running;
+  std::vector<int> exitStatus (runs.size (), -1);
+  uint64_t memPerRunKb = memPerRunMb * 1024;
+  uint32_t next = 0;
+  uint32_t failed = 0;
+
+  while (next < runs.size () || !running.empty ())
+    {
+      // Start as many runs as there are free cores and memory for. A freshly forked run
+      // hasn't allocated anything yet, so MemAvailable alone doesn't throttle: every run
+      // that hasn't been reaped keeps the part of memPerRunKb it has not allocated yet
+      // reserved, the rest is already missing from MemAvailable. At least one run is
+      // always kept going so that a bad estimate can't stall the campaign.
+      while (next < runs.size () && !freeCores.empty ())
+        {
+          uint64_t reservedKb = 0;
+          for (const auto &r : running)
+            {
+              uint64_t rssKb = GetRssKb (r.first);
+              reservedKb += rssKb < memPerRunKb ? memPerRunKb - rssKb : 0;
+            }
+          uint64_t availableKb = GetAvailableMemoryKb ();
+          if (!running.empty () && (availableKb < reservedKb || availableKb - reservedKb < memPerRunKb))
+            {
+              break;
+            }
+          int core = freeCores.back ();
+          freeCores.pop_back ();
+          pid_t pid = Launch (program, runs[next], core, simName);
+          if (pid < 0)
+            {
+              std::cerr << "fork failed: " << strerror (errno) << std::endl;
+              freeCores.push_back (core);
+              break;
+            }
+          running[pid] = {next, core};
+          ++next;
+        }
+
+      int status;
+      struct rusage usage;
+      pid_t pid = wait4 (-1, &status, 0, &usage);
+      if (pid < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          break;
+        }
+      auto it = running.find (pid);
+      if (it == running.end ())
+        {
+          continue;
+        }
+      const Run &run = runs[it->second.run];
+      freeCores.push_back (it->second.core);
+      running.erase (it);
+
+      // ru_maxrss is in kB on Linux
+      memPerRunKb = std::max<uint64_t> (memPerRunKb, usage.ru_maxrss);
+      exitStatus[run.id] = WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+      if (exitStatus[run.id] != 0)
+        {
+          ++failed;
+          std::cerr << "run " << run.id << " (seed " << run.seed << ") failed with status "
+                    << exitStatus[run.id] << ", see " << run.dir << "/stdout.log" << std::endl;
+        }
+      std::cout << "finished " << (next - running.size ()) << "/" << runs.size () << std::endl;
+    }
+
+  // Merge the per-run flow statistics.
+  std::ofstream flows ((outDir + "/flows.csv").c_str ());
+  std::ofstream summary ((outDir + "/summary.csv").c_str ());
+  flows << "config,worker,seed,flow,src,txPackets,rxPackets,txBytes,rxBytes,delaySum,jitterSum,echoRxPackets,echoDelaySum,rttSum\n";
+  summary << "config,parameters,seeds,flows,txPackets,rxPackets,packetLoss,meanDelay,meanJitter,meanRtt,rxBytes\n";
+  std::vector<FlowTotals> totals (configs.size ());
+  for (const Run &run : runs)
+    {
+      if (exitStatus[run.id] == 0 && !MergeRun (run, flows, totals[run.config]))
+        {
+          std::cerr << "run " << run.id << " produced no flowstats.csv" << std::endl;
+        }
+    }
+  for (uint32_t c = 0; c < configs.size (); ++c)
+    {
+      const FlowTotals &t = totals[c];
+      std::string parameters;
+      for (const std::string &p : configs[c])
+        {
+          parameters += (parameters.empty () ? "" : " ") + p;
+        }
+      summary << c << ",\"" << parameters << "\"," << t.seeds << "," << t.flows << ","
+              << t.txPackets << "," << t.rxPackets << ","
+              << (t.txPackets > 0 ? (t.txPackets - std::min (t.rxPackets, t.txPackets)) * 1.0 / t.txPackets : 0.0) << ","
+              << (t.rxPackets > 0 ? t.delaySum / t.rxPackets : 0.0) << ","
+              << (t.rxPackets > t.flows ? t.jitterSum / (t.rxPackets - t.flows) : 0.0) << ","
+              << (t.echoRxPackets > 0 ? t.rttSum / t.echoRxPackets : 0.0) << ","
+              << t.rxBytes << "\n";
+    }
+
+  std::cout << "wrote " << outDir << "/summary.csv";
+  if (failed > 0)
+    {
+      std::cout << " (" << failed << " runs failed)";
+    }
+  std::cout << std::endl;
+  return failed > 0 ? 1 : 0;
+}
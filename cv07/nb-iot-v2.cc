@@ -31,10 +31,13 @@
 #include "ns3/random-variable-stream.h"
 #include "ns3/lte-module.h"
 #include "ns3/netanim-module.h"
+#include "ns3/propagation-loss-model.h"
 #include "ns3/winner-plus-propagation-loss-model.h"
 
 #include "ns3/flow-monitor-module.h"
 #include "ns3/flow-monitor-helper.h"
+#include "rotating-pcap-sink.h"
+#include "mser.h"
 //#include "ns3/gtk-config-store.h"
 
 #include <chrono>
@@ -43,21 +46,1587 @@
 #include <ctime>    
 #include <fstream>
 #include <cmath>
+#include <deque>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
 using namespace ns3;
 
 
 
 NS_LOG_COMPONENT_DEFINE ("LenaNb");
 
+/**
+ * Echo server for a whole UE population on a single UDP socket.
+ *
+ * Replaces one UdpEchoServer (and one port) per UE on the remote host. All clients send to the
+ * same port; the server echoes every packet back to its sender like UdpEchoServer does. Each peer
+ * can be given a start time, before which its packets are dropped as they would be without a
+ * listening per-UE server; packets of unknown peers are dropped as well. The per-peer state is
+ * kept in a flat open-addressing hash table keyed by the peer's IPv4 address.
+ */
+class MultiClientEchoServer : public Application
+{
+public:
+  struct PeerStats
+  {
+    Time start;
+    uint32_t rxPackets = 0;
+    uint64_t rxBytes = 0;
+    uint32_t dropped = 0; // received before start
+  };
+
+  static TypeId GetTypeId (void);
+  MultiClientEchoServer ();
+  virtual ~MultiClientEchoServer ();
+
+  // Accepts packets of peer from start (absolute simulation time) on, resetting its statistics.
+  void AddPeer (Ipv4Address peer, Time start);
+  // Forgets peer, its packets are dropped again.
+  void RemovePeer (Ipv4Address peer);
+  // Moves the server to another port, closing the socket of the previous one.
+  void SetPort (uint16_t port);
+  const PeerStats *GetPeerStats (Ipv4Address peer) const;
+  uint32_t GetNPeers (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  struct Slot
+  {
+    uint32_t key = 0; // IPv4 address, 0 marks an empty slot
+    PeerStats stats;
+  };
+
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+  void HandleRead (Ptr<Socket> socket);
+  Slot *Find (uint32_t key) const;
+  Slot &Insert (uint32_t key);
+
+  uint16_t m_port;
+  Ptr<Socket> m_socket;
+  std::vector<Slot> m_table; // capacity is a power of two, at most half full
+  uint32_t m_nPeers;
+  TracedCallback<Ptr<const Packet> > m_rxTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (MultiClientEchoServer);
+
+TypeId
+MultiClientEchoServer::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MultiClientEchoServer")
+    .SetParent<Application> ()
+    .AddConstructor<MultiClientEchoServer> ()
+    .AddAttribute ("Port", "Port on which we listen for incoming packets.",
+                   UintegerValue (9),
+                   MakeUintegerAccessor (&MultiClientEchoServer::m_port),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddTraceSource ("Rx", "A packet has been received from a started peer",
+                     MakeTraceSourceAccessor (&MultiClientEchoServer::m_rxTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+MultiClientEchoServer::MultiClientEchoServer ()
+  : m_table (64),
+    m_nPeers (0)
+{
+}
+
+MultiClientEchoServer::~MultiClientEchoServer ()
+{
+}
+
+void
+MultiClientEchoServer::DoDispose (void)
+{
+  m_socket = 0;
+  Application::DoDispose ();
+}
+
+MultiClientEchoServer::Slot *
+MultiClientEchoServer::Find (uint32_t key) const
+{
+  uint32_t mask = m_table.size () - 1;
+  for (uint32_t i = (key * 2654435761u) & mask; ; i = (i + 1) & mask)
+    {
+      if (m_table[i].key == key)
+        {
+          return const_cast<Slot *> (&m_table[i]);
+        }
+      if (m_table[i].key == 0)
+        {
+          return 0;
+        }
+    }
+}
+
+MultiClientEchoServer::Slot &
+MultiClientEchoServer::Insert (uint32_t key)
+{
+  Slot *slot = Find (key);
+  if (slot != 0)
+    {
+      return *slot;
+    }
+  if (2 * (m_nPeers + 1) > m_table.size ())
+    {
+      std::vector<Slot> old (m_table.size () * 2);
+      old.swap (m_table);
+      for (const Slot &s : old)
+        {
+          if (s.key != 0)
+            {
+              uint32_t mask = m_table.size () - 1;
+              uint32_t i = (s.key * 2654435761u) & mask;
+              while (m_table[i].key != 0)
+                {
+                  i = (i + 1) & mask;
+                }
+              m_table[i] = s;
+            }
+        }
+    }
+  uint32_t mask = m_table.size () - 1;
+  uint32_t i = (key * 2654435761u) & mask;
+  while (m_table[i].key != 0)
+    {
+      i = (i + 1) & mask;
+    }
+  m_table[i].key = key;
+  m_nPeers++;
+  return m_table[i];
+}
+
+void
+MultiClientEchoServer::AddPeer (Ipv4Address peer, Time start)
+{
+  NS_ABORT_MSG_IF (peer.Get () == 0, "0.0.0.0 can't be a peer");
+  Slot &slot = Insert (peer.Get ());
+  slot.stats = PeerStats ();
+  slot.stats.start = start;
+}
+
+void
+MultiClientEchoServer::RemovePeer (Ipv4Address peer)
+{
+  Slot *slot = Find (peer.Get ());
+  if (slot == 0)
+    {
+      return;
+    }
+  m_nPeers--;
+  // backward shift deletion: move later entries of the probe sequence into the hole unless their
+  // home slot lies after it, so every remaining key stays reachable without tombstones
+  uint32_t mask = m_table.size () - 1;
+  uint32_t i = slot - &m_table[0];
+  for (uint32_t j = (i + 1) & mask; m_table[j].key != 0; j = (j + 1) & mask)
+    {
+      uint32_t home = (m_table[j].key * 2654435761u) & mask;
+      if (((j - home) & mask) >= ((j - i) & mask))
+        {
+          m_table[i] = m_table[j];
+          i = j;
+        }
+    }
+  m_table[i] = Slot ();
+}
+
+void
+MultiClientEchoServer::SetPort (uint16_t port)
+{
+  if (port == m_port)
+    {
+      return;
+    }
+  m_port = port;
+  if (m_socket != 0)
+    {
+      StopApplication ();
+      m_socket = 0;
+      StartApplication ();
+    }
+}
+
+const MultiClientEchoServer::PeerStats *
+MultiClientEchoServer::GetPeerStats (Ipv4Address peer) const
+{
+  Slot *slot = Find (peer.Get ());
+  return slot == 0 ? 0 : &slot->stats;
+}
+
+uint32_t
+MultiClientEchoServer::GetNPeers (void) const
+{
+  return m_nPeers;
+}
+
+void
+MultiClientEchoServer::StartApplication (void)
+{
+  if (m_socket == 0)
+    {
+      m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+      if (m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port)) == -1)
+        {
+          NS_FATAL_ERROR ("Failed to bind socket");
+        }
+    }
+  m_socket->SetRecvCallback (MakeCallback (&MultiClientEchoServer::HandleRead, this));
+}
+
+void
+MultiClientEchoServer::StopApplication (void)
+{
+  if (m_socket != 0)
+    {
+      m_socket->Close ();
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+    }
+}
+
+void
+MultiClientEchoServer::HandleRead (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      Slot *slot = Find (InetSocketAddress::ConvertFrom (from).GetIpv4 ().Get ());
+      if (slot == 0)
+        {
+          continue;
+        }
+      if (Simulator::Now () < slot->stats.start)
+        {
+          slot->stats.dropped++;
+          continue;
+        }
+      slot->stats.rxPackets++;
+      slot->stats.rxBytes += packet->GetSize ();
+      m_rxTrace (packet);
+
+      packet->RemoveAllPacketTags ();
+      packet->RemoveAllByteTags ();
+      socket->SendTo (packet, 0, from);
+    }
+}
+
+/**
+ * Echo client that can be pointed at another server and started again.
+ *
+ * A pooled UE stack of UePopulation serves one device after the other with a single instance.
+ * Like UdpEchoClient it sends packetSize bytes every interval and fires Tx for every request and
+ * Rx for every reply; Stop cancels the sending and closes the socket, so an idle stack keeps no
+ * socket and no pending event. The first 4 bytes of every request carry a sequence number, which
+ * the echo server returns unchanged, so a reply can be matched to its request (GetSequence).
+ */
+class ReusableEchoClient : public Application
+{
+public:
+  static TypeId GetTypeId (void);
+  ReusableEchoClient ();
+  virtual ~ReusableEchoClient ();
+
+  // Sends to server:port every interval, the first packet delay from now; replaces the previous target.
+  void Start (Ipv4Address server, uint16_t port, uint32_t packetSize, Time interval, Time delay);
+  void Stop (void);
+  // Sequence number of a request or of its echo reply.
+  static uint32_t GetSequence (Ptr<const Packet> packet);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+  void Send (void);
+  void HandleRead (Ptr<Socket> socket);
+
+  Ipv4Address m_server;
+  uint16_t m_port;
+  uint32_t m_packetSize;
+  Time m_interval;
+  uint32_t m_sequence;
+  Ptr<Socket> m_socket;
+  EventId m_sendEvent;
+  TracedCallback<Ptr<const Packet> > m_txTrace;
+  TracedCallback<Ptr<const Packet> > m_rxTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ReusableEchoClient);
+
+TypeId
+ReusableEchoClient::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ReusableEchoClient")
+    .SetParent<Application> ()
+    .AddConstructor<ReusableEchoClient> ()
+    .AddTraceSource ("Tx", "A new packet is created and is sent",
+                     MakeTraceSourceAccessor (&ReusableEchoClient::m_txTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("Rx", "A packet has been received",
+                     MakeTraceSourceAccessor (&ReusableEchoClient::m_rxTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+ReusableEchoClient::ReusableEchoClient ()
+  : m_port (0),
+    m_packetSize (0),
+    m_sequence (0)
+{
+}
+
+ReusableEchoClient::~ReusableEchoClient ()
+{
+}
+
+void
+ReusableEchoClient::DoDispose (void)
+{
+  Stop ();
+  Application::DoDispose ();
+}
+
+void
+ReusableEchoClient::Start (Ipv4Address server, uint16_t port, uint32_t packetSize, Time interval, Time delay)
+{
+  Stop ();
+  NS_ABORT_MSG_IF (packetSize < 4, "Echo requests need 4 bytes for the sequence number");
+  m_server = server;
+  m_port = port;
+  m_packetSize = packetSize;
+  m_interval = interval;
+  m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+  if (m_socket->Bind () == -1)
+    {
+      NS_FATAL_ERROR ("Failed to bind socket");
+    }
+  m_socket->Connect (InetSocketAddress (server, port));
+  m_socket->SetRecvCallback (MakeCallback (&ReusableEchoClient::HandleRead, this));
+  m_sendEvent = Simulator::Schedule (delay, &ReusableEchoClient::Send, this);
+}
+
+void
+ReusableEchoClient::Stop (void)
+{
+  m_sendEvent.Cancel ();
+  if (m_socket != 0)
+    {
+      m_socket->Close ();
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+      m_socket = 0;
+    }
+}
+
+void
+ReusableEchoClient::StartApplication (void)
+{
+  // started by Start
+}
+
+void
+ReusableEchoClient::StopApplication (void)
+{
+  Stop ();
+}
+
+uint32_t
+ReusableEchoClient::GetSequence (Ptr<const Packet> packet)
+{
+  uint8_t buffer[4] = {0, 0, 0, 0};
+  packet->CopyData (buffer, 4);
+  return uint32_t (buffer[0]) << 24 | buffer[1] << 16 | buffer[2] << 8 | buffer[3];
+}
+
+void
+ReusableEchoClient::Send (void)
+{
+  // the sequence number keeps counting across Start, so a late reply for a previous device can't match
+  std::vector<uint8_t> payload (m_packetSize, 0);
+  payload[0] = m_sequence >> 24;
+  payload[1] = m_sequence >> 16;
+  payload[2] = m_sequence >> 8;
+  payload[3] = m_sequence;
+  m_sequence++;
+  Ptr<Packet> packet = Create<Packet> (payload.data (), m_packetSize);
+  m_txTrace (packet);
+  NS_LOG_INFO ("At time " << Simulator::Now ().As (Time::S) << " client sent " << m_packetSize << " bytes to "
+               << m_server << " port " << m_port);
+  m_socket->Send (packet);
+  m_sendEvent = Simulator::Schedule (m_interval, &ReusableEchoClient::Send, this);
+}
+
+void
+ReusableEchoClient::HandleRead (Ptr<Socket> socket)
+{
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      NS_LOG_INFO ("At time " << Simulator::Now ().As (Time::S) << " client received " << packet->GetSize ()
+                   << " bytes from " << InetSocketAddress::ConvertFrom (from).GetIpv4 ()
+                   << " port " << InetSocketAddress::ConvertFrom (from).GetPort ());
+      m_rxTrace (packet);
+    }
+}
+
+/**
+ * Tag carried by the uplink packets tracked by WindowedFlowStats: the index of the considered UE
+ * and the time the packet was sent.
+ */
+class WindowedFlowTag : public Tag
+{
+public:
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+  uint32_t m_flow;
+  int64_t m_txTime; // in time steps
+};
+
+NS_OBJECT_ENSURE_REGISTERED (WindowedFlowTag);
+
+TypeId
+WindowedFlowTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::WindowedFlowTag")
+    .SetParent<Tag> ()
+    .AddConstructor<WindowedFlowTag> ();
+  return tid;
+}
+
+TypeId
+WindowedFlowTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+WindowedFlowTag::GetSerializedSize (void) const
+{
+  return 12;
+}
+
+void
+WindowedFlowTag::Serialize (TagBuffer i) const
+{
+  i.WriteU32 (m_flow);
+  i.WriteU64 (m_txTime);
+}
+
+void
+WindowedFlowTag::Deserialize (TagBuffer i)
+{
+  m_flow = i.ReadU32 ();
+  m_txTime = i.ReadU64 ();
+}
+
+void
+WindowedFlowTag::Print (std::ostream &os) const
+{
+  os << "flow=" << m_flow << " txTime=" << m_txTime;
+}
+
+// Whether the UE RRC is connected or on its way there; idle, camped and suspended states count as left.
+static bool
+IsRrcConnected (LteUeRrc::State state)
+{
+  switch (state)
+    {
+    case LteUeRrc::IDLE_RANDOM_ACCESS:
+    case LteUeRrc::IDLE_CONNECTING:
+    case LteUeRrc::CONNECTED_NORMALLY:
+    case LteUeRrc::CONNECTED_HANDOVER:
+    case LteUeRrc::CONNECTED_PHY_PROBLEM:
+    case LteUeRrc::CONNECTED_REESTABLISHING:
+      return true;
+    default:
+      return false;
+    }
+}
+
+/**
+ * Per-UE statistics of the echo exchanges that are started within a measurement window.
+ *
+ * Only the echo client and server of the considered UEs are connected, and a packet is only
+ * tagged (and thus tracked) when its client sends it within [start, stop). Everything else is
+ * dropped where the trace fires, so no state is kept for the Pre-Run and Post-Run UEs and the
+ * KPIs need no filtering afterwards. Uplink delay is measured client to server, downlink delay
+ * server to client. The clients have to be ReusableEchoClients: the echo server strips all packet
+ * tags, so a reply is matched to its tracked request by the sequence number in its payload, and
+ * replies to requests sent outside the window are ignored.
+ */
+class WindowedFlowStats : public SimpleRefCount<WindowedFlowStats>
+{
+public:
+  struct FlowStats
+  {
+    Ipv4Address address;
+    uint32_t txPackets = 0;
+    uint64_t txBytes = 0;
+    uint32_t ulRxPackets = 0;
+    uint64_t ulRxBytes = 0;
+    Time ulDelaySum;
+    Time ulJitterSum;
+    Time lastUlDelay;
+    uint32_t dlRxPackets = 0;
+    Time dlDelaySum;
+    Time rttSum;
+    Time timeFirstTx;
+    Time timeLastRx;
+    struct PendingEcho
+    {
+      uint32_t sequence;
+      Time txTime;
+      Time serverRxTime;
+    };
+    std::deque<PendingEcho> pendingEcho; // tracked requests received by the server, oldest first
+  };
+
+  WindowedFlowStats (Time start, Time stop);
+  void SetWindow (Time start, Time stop);
+  // Stops the simulation as soon as the window is closed, all its echo exchanges have completed and
+  // the UEs that took part in them have left RRC connected, so their RRC/MAC logs are complete.
+  void StopWhenDone (void);
+  // Tracks the echo exchange of one considered UE and returns its flow index. A server shared by
+  // several UEs is connected only once through AddServer, pass 0 as server for its clients then.
+  // rrc is the RRC of the UE, StopWhenDone waits for it.
+  uint32_t Add (Ipv4Address ueAddress, Ptr<Application> client, Ptr<Application> server, Ptr<LteUeRrc> rrc);
+  void AddServer (Ptr<Application> server);
+  // Disconnects client from flow. A flow without any exchange in the window is reused by the next Add.
+  void Remove (uint32_t flow, Ptr<Application> client);
+  const std::vector<FlowStats> &GetFlowStats (void) const;
+  bool Report (std::string statsFile, uint32_t worker, int seed) const;
+
+private:
+  static void ClientTx (Ptr<WindowedFlowStats> stats, uint32_t flow, Ptr<const Packet> packet);
+  static void ServerRx (Ptr<WindowedFlowStats> stats, Ptr<const Packet> packet);
+  static void ClientRx (Ptr<WindowedFlowStats> stats, uint32_t flow, Ptr<const Packet> packet);
+  static void RrcStateTransition (Ptr<WindowedFlowStats> stats, uint64_t imsi, uint16_t cellId, uint16_t rnti,
+                                  LteUeRrc::State oldState, LteUeRrc::State newState);
+  bool AnyRrcConnected (void) const;
+  void CheckDone (void);
+
+  Time m_start;
+  Time m_stop;
+  std::vector<FlowStats> m_flows;
+  std::vector<Ptr<LteUeRrc> > m_rrcs; // per flow
+  std::vector<uint32_t> m_freeFlows;
+  uint32_t m_outstanding = 0; // tracked exchanges without echo reply yet
+  bool m_stopWhenDone = false;
+  EventId m_checkDoneEvent;
+};
+
+WindowedFlowStats::WindowedFlowStats (Time start, Time stop)
+  : m_start (start),
+    m_stop (stop)
+{
+}
+
+void
+WindowedFlowStats::SetWindow (Time start, Time stop)
+{
+  m_start = start;
+  m_stop = stop;
+  if (m_stopWhenDone)
+    {
+      StopWhenDone ();
+    }
+}
+
+void
+WindowedFlowStats::StopWhenDone (void)
+{
+  m_stopWhenDone = true;
+  m_checkDoneEvent.Cancel ();
+  if (m_stop != Time::Max ())
+    {
+      m_checkDoneEvent = Simulator::Schedule (Max (m_stop - Simulator::Now (), Seconds (0)),
+                                              &WindowedFlowStats::CheckDone, Ptr<WindowedFlowStats> (this));
+    }
+}
+
+void
+WindowedFlowStats::CheckDone (void)
+{
+  if (m_stopWhenDone && Simulator::Now () >= m_stop && m_outstanding == 0 && !AnyRrcConnected ())
+    {
+      std::cout << "all exchanges of the window completed and their UEs left RRC connected, stopping at "
+                << Simulator::Now ().GetSeconds () << "s" << std::endl;
+      Simulator::Stop ();
+    }
+}
+
+bool
+WindowedFlowStats::AnyRrcConnected (void) const
+{
+  for (uint32_t i = 0; i < m_flows.size (); ++i)
+    {
+      if (m_flows[i].txPackets > 0 && m_rrcs[i] != 0 && IsRrcConnected (m_rrcs[i]->GetState ()))
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+WindowedFlowStats::RrcStateTransition (Ptr<WindowedFlowStats> stats, uint64_t imsi, uint16_t cellId, uint16_t rnti,
+                                       LteUeRrc::State oldState, LteUeRrc::State newState)
+{
+  if (!IsRrcConnected (newState))
+    {
+      stats->CheckDone ();
+    }
+}
+
+uint32_t
+WindowedFlowStats::Add (Ipv4Address ueAddress, Ptr<Application> client, Ptr<Application> server, Ptr<LteUeRrc> rrc)
+{
+  uint32_t flow;
+  if (m_freeFlows.empty ())
+    {
+      flow = m_flows.size ();
+      m_flows.push_back (FlowStats ());
+      m_rrcs.push_back (0);
+    }
+  else
+    {
+      flow = m_freeFlows.back ();
+      m_freeFlows.pop_back ();
+    }
+  m_flows[flow].address = ueAddress;
+  Ptr<WindowedFlowStats> self (this);
+  client->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&WindowedFlowStats::ClientTx, self, flow));
+  client->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&WindowedFlowStats::ClientRx, self, flow));
+  if (server != 0)
+    {
+      AddServer (server);
+    }
+  m_rrcs[flow] = rrc;
+  rrc->TraceConnectWithoutContext ("StateTransition", MakeBoundCallback (&WindowedFlowStats::RrcStateTransition, self));
+  return flow;
+}
+
+void
+WindowedFlowStats::AddServer (Ptr<Application> server)
+{
+  server->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&WindowedFlowStats::ServerRx, Ptr<WindowedFlowStats> (this)));
+}
+
+void
+WindowedFlowStats::Remove (uint32_t flow, Ptr<Application> client)
+{
+  Ptr<WindowedFlowStats> self (this);
+  client->TraceDisconnectWithoutContext ("Tx", MakeBoundCallback (&WindowedFlowStats::ClientTx, self, flow));
+  client->TraceDisconnectWithoutContext ("Rx", MakeBoundCallback (&WindowedFlowStats::ClientRx, self, flow));
+  m_rrcs[flow]->TraceDisconnectWithoutContext ("StateTransition",
+                                               MakeBoundCallback (&WindowedFlowStats::RrcStateTransition, self));
+  m_rrcs[flow] = 0;
+  if (m_flows[flow].txPackets == 0)
+    {
+      // nothing was tagged for this flow, so no packet in flight refers to it
+      m_flows[flow] = FlowStats ();
+      m_freeFlows.push_back (flow);
+    }
+}
+
+const std::vector<WindowedFlowStats::FlowStats> &
+WindowedFlowStats::GetFlowStats (void) const
+{
+  return m_flows;
+}
+
+void
+WindowedFlowStats::ClientTx (Ptr<WindowedFlowStats> stats, uint32_t flow, Ptr<const Packet> packet)
+{
+  Time now = Simulator::Now ();
+  if (now < stats->m_start || now >= stats->m_stop)
+    {
+      return;
+    }
+  WindowedFlowTag tag;
+  tag.m_flow = flow;
+  tag.m_txTime = now.GetTimeStep ();
+  packet->AddPacketTag (tag);
+
+  FlowStats &f = stats->m_flows[flow];
+  stats->m_outstanding++;
+  if (f.txPackets == 0)
+    {
+      f.timeFirstTx = now;
+    }
+  f.txPackets++;
+  f.txBytes += packet->GetSize ();
+}
+
+void
+WindowedFlowStats::ServerRx (Ptr<WindowedFlowStats> stats, Ptr<const Packet> packet)
+{
+  WindowedFlowTag tag;
+  if (!packet->PeekPacketTag (tag))
+    {
+      return;
+    }
+  Time now = Simulator::Now ();
+  Time txTime = TimeStep (tag.m_txTime);
+  Time delay = now - txTime;
+  FlowStats &f = stats->m_flows[tag.m_flow];
+  if (f.ulRxPackets > 0)
+    {
+      f.ulJitterSum += Abs (delay - f.lastUlDelay);
+    }
+  f.lastUlDelay = delay;
+  f.ulRxPackets++;
+  f.ulRxBytes += packet->GetSize ();
+  f.ulDelaySum += delay;
+  f.timeLastRx = now;
+  f.pendingEcho.push_back ({ReusableEchoClient::GetSequence (packet), txTime, now});
+}
+
+void
+WindowedFlowStats::ClientRx (Ptr<WindowedFlowStats> stats, uint32_t flow, Ptr<const Packet> packet)
+{
+  // The echo server strips all packet tags, so replies are matched to the tracked requests of the
+  // UE by sequence number; a reply to a request sent before the window matches none of them.
+  FlowStats &f = stats->m_flows[flow];
+  uint32_t sequence = ReusableEchoClient::GetSequence (packet);
+  auto pending = std::find_if (f.pendingEcho.begin (), f.pendingEcho.end (),
+                               [sequence] (const FlowStats::PendingEcho &e) { return e.sequence == sequence; });
+  if (pending == f.pendingEcho.end ())
+    {
+      return;
+    }
+  Time now = Simulator::Now ();
+  f.dlRxPackets++;
+  f.dlDelaySum += now - pending->serverRxTime;
+  f.rttSum += now - pending->txTime;
+  f.pendingEcho.erase (pending);
+  stats->m_outstanding--;
+  stats->CheckDone ();
+}
+
+bool
+WindowedFlowStats::Report (std::string statsFile, uint32_t worker, int seed) const
+{
+  std::ofstream statsOut;
+  if (!statsFile.empty ())
+    {
+      statsOut.open (statsFile.c_str (), std::ofstream::out | std::ofstream::trunc);
+      if (!statsOut.is_open ())
+        {
+          std::cerr << "Can't open file " << statsFile << std::endl;
+          return false;
+        }
+      statsOut << "worker,seed,flow,src,txPackets,rxPackets,txBytes,rxBytes,delaySum,jitterSum,echoRxPackets,echoDelaySum,rttSum" << std::endl;
+    }
+
+  std::cout << std::endl << "*** Windowed statistic of the considered UEs (" << m_start.GetSeconds ()
+            << "s - " << m_stop.GetSeconds () << "s) ***" << std::endl;
+  for (uint32_t i = 0; i < m_flows.size (); ++i)
+    {
+      const FlowStats &f = m_flows[i];
+      if (f.txPackets == 0)
+        {
+          continue; // UE did not start an exchange within the window
+        }
+      std::cout << "UE: " << i << " (" << f.address << ")" << std::endl;
+      std::cout << "Tx Packets/Bytes: " << f.txPackets << "/" << f.txBytes << std::endl;
+      std::cout << "Rx Packets/Bytes: " << f.ulRxPackets << "/" << f.ulRxBytes << std::endl;
+      if (f.ulRxPackets > 0)
+        {
+          std::cout << "Mean UL delay: " << f.ulDelaySum.GetSeconds () / f.ulRxPackets * 1000 << "ms" << std::endl;
+        }
+      if (f.dlRxPackets > 0)
+        {
+          std::cout << "Mean echo delay: " << f.dlDelaySum.GetSeconds () / f.dlRxPackets * 1000 << "ms" << std::endl;
+          std::cout << "Mean RTT: " << f.rttSum.GetSeconds () / f.dlRxPackets * 1000 << "ms" << std::endl;
+        }
+      std::cout << "Lost Packets: " << f.txPackets - f.ulRxPackets << std::endl;
+      std::cout << "------------------------------------------------" << std::endl;
+
+      if (statsOut.is_open ())
+        {
+          statsOut << worker << "," << seed << "," << i << "," << f.address << ","
+                   << f.txPackets << "," << f.ulRxPackets << ","
+                   << f.txBytes << "," << f.ulRxBytes << ","
+                   << f.ulDelaySum.GetSeconds () << "," << f.ulJitterSum.GetSeconds () << ","
+                   << f.dlRxPackets << "," << f.dlDelaySum.GetSeconds () << "," << f.rttSum.GetSeconds () << std::endl;
+        }
+    }
+  return true;
+}
+
+/**
+ * Online replacement for the fixed Pre-Run/Post-Run schedule.
+ *
+ * Every check interval the number of UEs with an outstanding echo exchange (the channel occupancy)
+ * is sampled. Warm-up is considered over as soon as at least batchSize exchanges have completed and
+ * the global MSER-5 minimum of that series lies in its first half (see mser.h); from then on WindowedFlowStats tracks every exchange that is started. The
+ * completion times (RTTs) of these exchanges are grouped into batches, and the measurement window
+ * is closed once the 95 % batch-means confidence interval of the mean completion time is within
+ * ciTarget of the mean. The simulation then only runs for drainTime more, so that the exchanges
+ * started in the window can complete.
+ */
+class SteadyStateDetector : public SimpleRefCount<SteadyStateDetector>
+{
+public:
+  SteadyStateDetector (Ptr<WindowedFlowStats> stats, Time checkInterval, uint32_t batchSize,
+                       uint32_t minBatches, double ciTarget, Time drainTime);
+  void Add (Ptr<Application> client);
+  void Start (void);
+
+private:
+  static void ClientTx (Ptr<SteadyStateDetector> detector, uint32_t ue, Ptr<const Packet> packet);
+  static void ClientRx (Ptr<SteadyStateDetector> detector, uint32_t ue, Ptr<const Packet> packet);
+  void Check (void);
+
+  Ptr<WindowedFlowStats> m_stats;
+  Time m_checkInterval;
+  uint32_t m_batchSize;
+  uint32_t m_minBatches;
+  double m_ciTarget;
+  Time m_drainTime;
+
+  std::vector<Time> m_pendingSince; // per UE, negative if no exchange is outstanding
+  uint32_t m_occupancy = 0;
+  uint32_t m_completed = 0;
+  std::vector<double> m_occupancySamples;
+  bool m_measuring = false;
+  Time m_measureStart;
+  std::vector<double> m_completionTimes;
+};
+
+SteadyStateDetector::SteadyStateDetector (Ptr<WindowedFlowStats> stats, Time checkInterval, uint32_t batchSize,
+                                          uint32_t minBatches, double ciTarget, Time drainTime)
+  : m_stats (stats),
+    m_checkInterval (checkInterval),
+    m_batchSize (batchSize),
+    m_minBatches (minBatches),
+    m_ciTarget (ciTarget),
+    m_drainTime (drainTime)
+{
+}
+
+void
+SteadyStateDetector::Add (Ptr<Application> client)
+{
+  uint32_t ue = m_pendingSince.size ();
+  m_pendingSince.push_back (Seconds (-1));
+  Ptr<SteadyStateDetector> self (this);
+  client->TraceConnectWithoutContext ("Tx", MakeBoundCallback (&SteadyStateDetector::ClientTx, self, ue));
+  client->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&SteadyStateDetector::ClientRx, self, ue));
+}
+
+void
+SteadyStateDetector::Start (void)
+{
+  Simulator::Schedule (m_checkInterval, &SteadyStateDetector::Check, Ptr<SteadyStateDetector> (this));
+}
+
+void
+SteadyStateDetector::ClientTx (Ptr<SteadyStateDetector> detector, uint32_t ue, Ptr<const Packet> packet)
+{
+  if (detector->m_pendingSince[ue].IsNegative ())
+    {
+      detector->m_occupancy++;
+    }
+  detector->m_pendingSince[ue] = Simulator::Now ();
+}
+
+void
+SteadyStateDetector::ClientRx (Ptr<SteadyStateDetector> detector, uint32_t ue, Ptr<const Packet> packet)
+{
+  Time since = detector->m_pendingSince[ue];
+  if (since.IsNegative ())
+    {
+      return;
+    }
+  detector->m_occupancy--;
+  detector->m_completed++;
+  detector->m_pendingSince[ue] = Seconds (-1);
+  if (detector->m_measuring && since >= detector->m_measureStart)
+    {
+      detector->m_completionTimes.push_back ((Simulator::Now () - since).GetSeconds ());
+    }
+}
+
+void
+SteadyStateDetector::Check (void)
+{
+  Time now = Simulator::Now ();
+  m_occupancySamples.push_back (m_occupancy);
+
+  if (!m_measuring)
+    {
+      // an idle cell at the start looks perfectly stationary, so wait for some completed exchanges first
+      int64_t truncation = m_completed >= m_batchSize ? Mser5 (m_occupancySamples) : -1;
+      if (truncation >= 0)
+        {
+          m_measuring = true;
+          m_measureStart = now;
+          m_stats->SetWindow (now, Time::Max ());
+          std::cout << "steady state reached at " << now.GetSeconds () << "s (warm-up ended at "
+                    << (truncation + 1) * m_checkInterval.GetSeconds () << "s)" << std::endl;
+        }
+    }
+  else
+    {
+      uint32_t k = m_completionTimes.size () / m_batchSize;
+      if (k >= m_minBatches && k >= 2)
+        {
+          std::vector<double> batchMeans (k, 0.0);
+          double mean = 0;
+          for (uint32_t i = 0; i < k * m_batchSize; ++i)
+            {
+              batchMeans[i / m_batchSize] += m_completionTimes[i] / m_batchSize;
+            }
+          for (double b : batchMeans)
+            {
+              mean += b / k;
+            }
+          double var = 0;
+          for (double b : batchMeans)
+            {
+              var += (b - mean) * (b - mean) / (k - 1);
+            }
+          // two-sided 97.5 % quantiles of Student's t distribution for 1..30 degrees of freedom
+          static const double t975[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+          double t = k - 1 <= 30 ? t975[k - 2] : 1.96;
+          double halfWidth = t * std::sqrt (var / k);
+          if (mean > 0 && halfWidth / mean <= m_ciTarget)
+            {
+              m_stats->SetWindow (m_measureStart, now);
+              std::cout << "mean completion time " << mean * 1000 << "ms +- " << halfWidth * 1000
+                        << "ms after " << k << " batches, stopping measurement at " << now.GetSeconds () << "s"
+                        << std::endl;
+              Simulator::Stop (m_drainTime);
+              return;
+            }
+        }
+    }
+  Simulator::Schedule (m_checkInterval, &SteadyStateDetector::Check, Ptr<SteadyStateDetector> (this));
+}
+
+// Applies the Cellular IoT optimization and Early Data Transmission settings to one UE.
+static void
+ConfigureUeRrc (Ptr<NetDevice> ueDevice, bool ciot, bool edt)
+{
+  Ptr<LteUeRrc> ueRrc = ueDevice->GetObject<LteUeNetDevice> ()->GetRrc ();
+  ueRrc->SetAttribute ("CIoT-Opt", BooleanValue (ciot));
+  ueRrc->SetAttribute ("EDT", BooleanValue (edt));
+}
+
+// Creates the logging directory of one configuration and returns the prefix for the RRC/MAC log files.
+static std::string
+SetupLogDir (std::string simName, uint32_t numUes, Time simTime, bool ciot, bool edt,
+             std::time_t start_time, uint32_t worker, int seed)
+{
+  std::string logdir = "logs/";
+  std::string makedir = "mkdir -p ";
+  std::string techdir = makedir;
+
+  techdir += logdir;
+  int z = std::system(techdir.c_str());
+  //std::cout << z;
+  techdir += "/";
+  techdir += simName;
+  techdir += "/";
+  z = std::system(techdir.c_str());
+  std::cout << z;
+  logdir += simName;
+  logdir += "/";
+  logdir += std::to_string(numUes);
+  logdir += "_";
+  logdir += std::to_string(std::round(simTime.GetSeconds()));
+  logdir += "_";
+  logdir += std::to_string(ciot);
+  logdir += "_";
+  logdir += std::to_string(edt);
+  
+  std::string top_dirmakedir = makedir+logdir; 
+  int a = std::system(top_dirmakedir.c_str());
+  std::cout << a << std::endl;
+  logdir += "/";
+  
+  auto tm = *std::localtime(&start_time);
+  std::stringstream ss;
+  ss << std::put_time(&tm, "%d_%m_%Y_%H_%M_%S");
+  logdir += ss.str();
+  logdir += "_";
+  logdir += std::to_string(worker);
+  logdir += "_";
+  logdir += std::to_string(seed);
+  logdir += "_";  
+  return logdir;
+}
+
+// Points the RRC/MAC logs of the UEs [first, last) and of the eNB to logdir.
+static void
+SetLogDirs (NetDeviceContainer ueLteDevs, uint32_t first, uint32_t last, Ptr<NetDevice> enbDevice, std::string logdir)
+{
+  for (uint32_t i = first; i < last; i++)
+    {
+      Ptr<LteUeNetDevice> ueLteDevice = ueLteDevs.Get(i)->GetObject<LteUeNetDevice> ();
+      ueLteDevice->GetRrc()->SetLogDir(logdir);
+      ueLteDevice->GetMac()->SetLogDir(logdir);
+    }
+  Ptr<LteEnbRrc> enbRrc = enbDevice->GetObject<LteEnbNetDevice>()->GetRrc();
+  enbRrc->SetLogDir(logdir);
+}
+
+/**
+ * Population manager for sparse NB-IoT traffic: instead of building all 3*X UE stacks before
+ * Simulator::Run, each device gets a node with LTE device, IP stack and attachment only leadTime
+ * before its access time. Once the echo exchange of a device has completed and the UE RRC has left
+ * the connected states (released to idle or suspended), its node returns to a pool and serves
+ * the next device, moved to that device's position and reconfigured. The number of stacks in
+ * memory is thus bounded by the number of concurrently active devices rather than by the
+ * population size. A pooled stack keeps its IMSI, so to the network a reused stack looks like a
+ * known device waking up again. Devices whose next packet would still fall into the simulated
+ * horizon keep their stack. Each stack has one ReusableEchoClient (and one MultiClientEchoServer
+ * on the remote host unless a shared server is set) that is re-targeted to every device it serves;
+ * the per-device server peer and flow statistics are released with the stack. The CIoT-Opt/EDT
+ * setting and the log directory of a device are applied at its access time, so settings changed
+ * after the stack was activated (snapshot variants) still reach it.
+ */
+class UePopulation : public SimpleRefCount<UePopulation>
+{
+public:
+  UePopulation (Ptr<LteHelper> lteHelper, Ptr<PointToPointEpcHelper> epcHelper, Ptr<NetDevice> enbDevice,
+                Ptr<Node> remoteHost, Ipv4Address remoteHostAddr, Time leadTime, Time horizon);
+  // CIoT-Opt/EDT settings for the devices of phase fromPhase and later.
+  void SetRrcConfig (uint32_t fromPhase, bool ciot, bool edt);
+  void SetLogDir (std::string logdir);
+  // Devices of phase 1 (or of all phases if allPhases) are reported to stats, all to detector if set.
+  void SetStats (Ptr<WindowedFlowStats> stats, bool allPhases, Ptr<SteadyStateDetector> detector);
+  // Serve all devices with one shared echo server instead of one server per device.
+  void SetSharedServer (Ptr<MultiClientEchoServer> server, uint16_t port);
+  void Add (uint32_t phase, Time access, Vector position, uint16_t port, uint32_t packetSize, Time interval);
+  uint32_t GetNDevices (void) const;
+  uint32_t GetNStacks (void) const;
+
+private:
+  struct Device
+  {
+    uint32_t phase;
+    Time access;
+    Vector position;
+    uint16_t port;
+    uint32_t packetSize;
+    Time interval;
+  };
+
+  void Activate (uint32_t device);
+  void Configure (uint32_t device, uint32_t stack);
+  uint32_t CreateStack (uint16_t port);
+  static void Completed (Ptr<UePopulation> population, uint32_t stack, Ptr<const Packet> packet);
+  static void RrcStateTransition (Ptr<UePopulation> population, uint32_t stack, uint64_t imsi, uint16_t cellId,
+                                  uint16_t rnti, LteUeRrc::State oldState, LteUeRrc::State newState);
+  void Release (uint32_t stack);
+
+  Ptr<LteHelper> m_lteHelper;
+  Ptr<PointToPointEpcHelper> m_epcHelper;
+  Ptr<NetDevice> m_enbDevice;
+  Ptr<Node> m_remoteHost;
+  Ipv4Address m_remoteHostAddr;
+  Time m_leadTime;
+  Time m_horizon;
+  std::string m_logdir;
+  std::vector<std::pair<bool, bool> > m_rrcConfig; // (ciot, edt) per phase
+  Ptr<WindowedFlowStats> m_stats;
+  bool m_statsAllPhases = false;
+  Ptr<SteadyStateDetector> m_detector;
+  Ptr<MultiClientEchoServer> m_sharedServer;
+  uint16_t m_sharedPort = 0;
+
+  std::vector<Device> m_devices;
+  NodeContainer m_nodes;
+  NetDeviceContainer m_ueDevs;
+  std::vector<Ipv4Address> m_addresses;
+  std::vector<Ptr<ReusableEchoClient> > m_clients;
+  std::vector<Ptr<MultiClientEchoServer> > m_servers; // 0 with a shared server
+  std::vector<uint32_t> m_flows; // WindowedFlowStats flow of the current device, or NO_FLOW
+  std::vector<bool> m_busy;
+  std::vector<bool> m_recyclable; // the current device sends nothing more within the horizon
+  std::vector<bool> m_awaitIdle; // exchange completed, released once the RRC leaves connected
+  std::vector<uint32_t> m_free;
+
+  static constexpr uint32_t NO_FLOW = std::numeric_limits<uint32_t>::max ();
+};
+
+UePopulation::UePopulation (Ptr<LteHelper> lteHelper, Ptr<PointToPointEpcHelper> epcHelper, Ptr<NetDevice> enbDevice,
+                            Ptr<Node> remoteHost, Ipv4Address remoteHostAddr, Time leadTime, Time horizon)
+  : m_lteHelper (lteHelper),
+    m_epcHelper (epcHelper),
+    m_enbDevice (enbDevice),
+    m_remoteHost (remoteHost),
+    m_remoteHostAddr (remoteHostAddr),
+    m_leadTime (leadTime),
+    m_horizon (horizon),
+    m_rrcConfig (3, std::make_pair (true, true))
+{
+}
+
+void
+UePopulation::SetRrcConfig (uint32_t fromPhase, bool ciot, bool edt)
+{
+  for (uint32_t phase = fromPhase; phase < m_rrcConfig.size (); ++phase)
+    {
+      m_rrcConfig[phase] = std::make_pair (ciot, edt);
+    }
+}
+
+void
+UePopulation::SetLogDir (std::string logdir)
+{
+  m_logdir = logdir;
+  SetLogDirs (m_ueDevs, 0, m_ueDevs.GetN (), m_enbDevice, logdir);
+}
+
+void
+UePopulation::SetStats (Ptr<WindowedFlowStats> stats, bool allPhases, Ptr<SteadyStateDetector> detector)
+{
+  m_stats = stats;
+  m_statsAllPhases = allPhases;
+  m_detector = detector;
+}
+
+void
+UePopulation::SetSharedServer (Ptr<MultiClientEchoServer> server, uint16_t port)
+{
+  m_sharedServer = server;
+  m_sharedPort = port;
+}
+
+void
+UePopulation::Add (uint32_t phase, Time access, Vector position, uint16_t port, uint32_t packetSize, Time interval)
+{
+  Device device = {phase, access, position, port, packetSize, interval};
+  m_devices.push_back (device);
+  Simulator::Schedule (Max (access - m_leadTime, Seconds (0)), &UePopulation::Activate, Ptr<UePopulation> (this),
+                       m_devices.size () - 1);
+}
+
+uint32_t
+UePopulation::GetNDevices (void) const
+{
+  return m_devices.size ();
+}
+
+uint32_t
+UePopulation::GetNStacks (void) const
+{
+  return m_nodes.GetN ();
+}
+
+uint32_t
+UePopulation::CreateStack (uint16_t port)
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (node);
+  NetDeviceContainer ueLteDev = m_lteHelper->InstallUeDevice (NodeContainer (node));
+
+  InternetStackHelper internet;
+  internet.Install (node);
+  Ipv4InterfaceContainer ueIpIface = m_epcHelper->AssignUeIpv4Address (ueLteDev);
+  Ipv4StaticRoutingHelper ipv4RoutingHelper;
+  Ptr<Ipv4StaticRouting> ueStaticRouting = ipv4RoutingHelper.GetStaticRouting (node->GetObject<Ipv4> ());
+  ueStaticRouting->SetDefaultRoute (m_epcHelper->GetUeDefaultGatewayAddress (), 1);
+  m_lteHelper->AttachSuspendedNb (ueLteDev.Get (0), m_enbDevice);
+
+  Ptr<LteUeNetDevice> ueLteDevice = ueLteDev.Get (0)->GetObject<LteUeNetDevice> ();
+  ueLteDevice->GetRrc ()->SetLogDir (m_logdir);
+  ueLteDevice->GetMac ()->SetLogDir (m_logdir);
+
+  uint32_t stack = m_nodes.GetN ();
+  Ptr<ReusableEchoClient> client = CreateObject<ReusableEchoClient> ();
+  node->AddApplication (client);
+  Ptr<MultiClientEchoServer> server;
+  if (!m_sharedServer)
+    {
+      server = CreateObject<MultiClientEchoServer> ();
+      server->SetAttribute ("Port", UintegerValue (port));
+      m_remoteHost->AddApplication (server);
+      if (m_stats)
+        {
+          m_stats->AddServer (server);
+        }
+    }
+  // the detector only tracks whether an exchange is outstanding, which is per stack
+  if (m_detector)
+    {
+      m_detector->Add (client);
+    }
+  client->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&UePopulation::Completed, Ptr<UePopulation> (this), stack));
+  ueLteDevice->GetRrc ()->TraceConnectWithoutContext ("StateTransition",
+                                                      MakeBoundCallback (&UePopulation::RrcStateTransition,
+                                                                         Ptr<UePopulation> (this), stack));
+
+  m_nodes.Add (node);
+  m_ueDevs.Add (ueLteDev);
+  m_addresses.push_back (ueIpIface.GetAddress (0));
+  m_clients.push_back (client);
+  m_servers.push_back (server);
+  m_flows.push_back (NO_FLOW);
+  m_busy.push_back (false);
+  m_recyclable.push_back (false);
+  m_awaitIdle.push_back (false);
+  return stack;
+}
+
+void
+UePopulation::Activate (uint32_t device)
+{
+  const Device &d = m_devices[device];
+  uint32_t stack;
+  if (m_free.empty ())
+    {
+      stack = CreateStack (d.port);
+    }
+  else
+    {
+      stack = m_free.back ();
+      m_free.pop_back ();
+    }
+  m_busy[stack] = true;
+  m_recyclable[stack] = d.access + d.interval >= m_horizon;
+
+  m_nodes.Get (stack)->GetObject<MobilityModel> ()->SetPosition (d.position);
+  // scheduled before the client, so it runs first at the access time
+  Time delay = d.access - Simulator::Now ();
+  Simulator::Schedule (delay, &UePopulation::Configure, Ptr<UePopulation> (this), device, stack);
+
+  Ptr<MultiClientEchoServer> server = m_servers[stack];
+  uint16_t port = d.port;
+  if (m_sharedServer)
+    {
+      server = m_sharedServer;
+      port = m_sharedPort;
+    }
+  else
+    {
+      server->SetPort (port);
+    }
+  server->AddPeer (m_addresses[stack], d.access);
+
+  if (m_stats && (d.phase == 1 || m_statsAllPhases))
+    {
+      m_flows[stack] = m_stats->Add (m_addresses[stack], m_clients[stack], 0,
+                                     m_ueDevs.Get (stack)->GetObject<LteUeNetDevice> ()->GetRrc ());
+    }
+  m_clients[stack]->Start (m_remoteHostAddr, port, d.packetSize, d.interval, delay);
+}
+
+void
+UePopulation::Configure (uint32_t device, uint32_t stack)
+{
+  const Device &d = m_devices[device];
+  Ptr<LteUeNetDevice> ueLteDevice = m_ueDevs.Get (stack)->GetObject<LteUeNetDevice> ();
+  if (d.phase == 1)
+    {
+      ueLteDevice->GetRrc ()->EnableLogging ();
+    }
+  ConfigureUeRrc (m_ueDevs.Get (stack), m_rrcConfig[d.phase].first, m_rrcConfig[d.phase].second);
+  ueLteDevice->GetRrc ()->SetLogDir (m_logdir);
+  ueLteDevice->GetMac ()->SetLogDir (m_logdir);
+}
+
+void
+UePopulation::Completed (Ptr<UePopulation> population, uint32_t stack, Ptr<const Packet> packet)
+{
+  if (population->m_busy[stack] && population->m_recyclable[stack])
+    {
+      population->m_busy[stack] = false;
+      Ptr<LteUeRrc> rrc = population->m_ueDevs.Get (stack)->GetObject<LteUeNetDevice> ()->GetRrc ();
+      if (IsRrcConnected (rrc->GetState ()))
+        {
+          population->m_awaitIdle[stack] = true;
+        }
+      else
+        {
+          Simulator::ScheduleNow (&UePopulation::Release, population, stack);
+        }
+    }
+}
+
+void
+UePopulation::RrcStateTransition (Ptr<UePopulation> population, uint32_t stack, uint64_t imsi, uint16_t cellId,
+                                  uint16_t rnti, LteUeRrc::State oldState, LteUeRrc::State newState)
+{
+  if (population->m_awaitIdle[stack] && !IsRrcConnected (newState))
+    {
+      population->m_awaitIdle[stack] = false;
+      // not from within the RRC state change itself
+      Simulator::ScheduleNow (&UePopulation::Release, population, stack);
+    }
+}
+
+void
+UePopulation::Release (uint32_t stack)
+{
+  m_clients[stack]->Stop ();
+  if (m_flows[stack] != NO_FLOW)
+    {
+      m_stats->Remove (m_flows[stack], m_clients[stack]);
+      m_flows[stack] = NO_FLOW;
+    }
+  (m_sharedServer ? m_sharedServer : m_servers[stack])->RemovePeer (m_addresses[stack]);
+  m_free.push_back (stack);
+}
+
+/**
+ * Propagation loss model that memoizes the loss of another model per link.
+ *
+ * The eNB and all UEs of this scenario never move, yet the wrapped model (Winner+ here) is
+ * evaluated again for every transmission towards every receiver. This model evaluates it once
+ * per (transmitter, receiver) pair and keeps the loss in a hash table keyed by that pair, so only
+ * the links that are actually used (eNB <-> UE) take memory. Every mobility model carries a
+ * version that a course change increments; an entry is only valid while the versions of both
+ * ends match the ones it was computed with, so moving or repositioned nodes still get fresh
+ * values. Precompute fills the table for given node pairs before the run so the wrapped model
+ * doesn't show up in the profile at all. The wrapped model is created from ModelType with its
+ * default attribute values, so it has to be configured with Config::SetDefault. The cached loss
+ * doesn't depend on the transmit power, as is the case for all distance based models.
+ */
+class CachedPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void);
+  CachedPropagationLossModel ();
+  virtual ~CachedPropagationLossModel ();
+
+  // Computes the losses between all nodes of a and b, in both directions, in every instance.
+  static void PrecomputeAll (NodeContainer a, NodeContainer b);
+
+private:
+  struct Link
+  {
+    double loss; // [dB]
+    uint32_t txVersion;
+    uint32_t rxVersion;
+  };
+
+  virtual double DoCalcRxPower (double txPowerDbm,
+                                Ptr<MobilityModel> a,
+                                Ptr<MobilityModel> b) const;
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  Ptr<PropagationLossModel> GetModel (void) const;
+  uint32_t GetIndex (Ptr<MobilityModel> model) const;
+  void CourseChange (Ptr<const MobilityModel> model);
+  double GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+
+  std::string m_modelType;
+  mutable Ptr<PropagationLossModel> m_model;
+  mutable std::unordered_map<const MobilityModel *, uint32_t> m_index;
+  mutable std::vector<uint32_t> m_version; // per mobility model, incremented on every course change
+  mutable std::unordered_map<uint64_t, Link> m_links; // keyed by (tx index << 32) | rx index
+
+  static std::vector<CachedPropagationLossModel *> s_instances;
+};
+
+std::vector<CachedPropagationLossModel *> CachedPropagationLossModel::s_instances;
+
+NS_OBJECT_ENSURE_REGISTERED (CachedPropagationLossModel);
+
+TypeId
+CachedPropagationLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CachedPropagationLossModel")
+    .SetParent<PropagationLossModel> ()
+    .AddConstructor<CachedPropagationLossModel> ()
+    .AddAttribute ("ModelType", "Type of the propagation loss model whose results are cached",
+                   StringValue ("ns3::WinnerPlusPropagationLossModel"),
+                   MakeStringAccessor (&CachedPropagationLossModel::m_modelType),
+                   MakeStringChecker ())
+  ;
+  return tid;
+}
+
+CachedPropagationLossModel::CachedPropagationLossModel ()
+{
+  s_instances.push_back (this);
+}
+
+CachedPropagationLossModel::~CachedPropagationLossModel ()
+{
+  s_instances.erase (std::find (s_instances.begin (), s_instances.end (), this));
+}
+
+void
+CachedPropagationLossModel::PrecomputeAll (NodeContainer a, NodeContainer b)
+{
+  for (CachedPropagationLossModel *instance : s_instances)
+    {
+      instance->m_links.reserve (instance->m_links.size () + 2 * size_t (a.GetN ()) * b.GetN ());
+      for (uint32_t i = 0; i < a.GetN (); ++i)
+        {
+          Ptr<MobilityModel> ma = a.Get (i)->GetObject<MobilityModel> ();
+          for (uint32_t j = 0; j < b.GetN (); ++j)
+            {
+              Ptr<MobilityModel> mb = b.Get (j)->GetObject<MobilityModel> ();
+              instance->GetLoss (ma, mb);
+              instance->GetLoss (mb, ma);
+            }
+        }
+    }
+}
+
+Ptr<PropagationLossModel>
+CachedPropagationLossModel::GetModel (void) const
+{
+  if (!m_model)
+    {
+      ObjectFactory factory;
+      factory.SetTypeId (m_modelType);
+      m_model = factory.Create<PropagationLossModel> ();
+    }
+  return m_model;
+}
+
+int64_t
+CachedPropagationLossModel::DoAssignStreams (int64_t stream)
+{
+  return GetModel ()->AssignStreams (stream);
+}
+
+uint32_t
+CachedPropagationLossModel::GetIndex (Ptr<MobilityModel> model) const
+{
+  auto it = m_index.find (PeekPointer (model));
+  if (it != m_index.end ())
+    {
+      return it->second;
+    }
+  uint32_t index = m_version.size ();
+  m_index.emplace (PeekPointer (model), index);
+  m_version.push_back (0);
+  model->TraceConnectWithoutContext ("CourseChange",
+                                     MakeCallback (&CachedPropagationLossModel::CourseChange,
+                                                   const_cast<CachedPropagationLossModel *> (this)));
+  return index;
+}
+
+void
+CachedPropagationLossModel::CourseChange (Ptr<const MobilityModel> model)
+{
+  m_version[m_index.at (PeekPointer (model))]++;
+}
+
+double
+CachedPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+  uint32_t tx = GetIndex (a);
+  uint32_t rx = GetIndex (b);
+  Link &link = m_links[(uint64_t (tx) << 32) | rx];
+  if (link.txVersion != m_version[tx] + 1 || link.rxVersion != m_version[rx] + 1)
+    {
+      // versions are stored + 1, so a newly inserted (zeroed) entry never matches
+      link.loss = -GetModel ()->CalcRxPower (0, a, b);
+      link.txVersion = m_version[tx] + 1;
+      link.rxVersion = m_version[rx] + 1;
+    }
+  return link.loss;
+}
+
+double
+CachedPropagationLossModel::DoCalcRxPower (double txPowerDbm,
+                                           Ptr<MobilityModel> a,
+                                           Ptr<MobilityModel> b) const
+{
+  return txPowerDbm - GetLoss (a, b);
+}
+
+// Prints the per-flow statistics of all phases and writes them to flowmonFile.
+static void
+ReportFlowStats (Ptr<FlowMonitor> monitor, FlowMonitorHelper &flowMonHelper, std::string flowmonFile)
+{
+  monitor->CheckForLostPackets();
+  Ptr <Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowMonHelper.GetClassifier());
+  std::map <FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
+
+  monitor->SerializeToXmlFile(flowmonFile, true, true);
+
+  std::cout << std::endl << "*** Flow monitor statistic ***" << std::endl;
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin(); i != stats.end(); ++i) {
+
+      // if (i-> first > 2) {
+      // double Delay, DataRate;
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(i->first);
+      std::cout << "Flow ID: " << i->first << std::endl;
+      std::cout << "Src add: " << t.sourceAddress << "-> Dst add: " << t.destinationAddress << std::endl;
+      std::cout << "Src port: " << t.sourcePort << "-> Dst port: " << t.destinationPort << std::endl;
+      std::cout << "Tx Packets/Bytes: " << i->second.txPackets << "/" << i->second.txBytes << std::endl;
+      std::cout << "Rx Packets/Bytes: " << i->second.rxPackets << "/" << i->second.rxBytes << std::endl;
+      std::cout << "Throughput: " << i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds()) / 1024 << "kb/s" << std::endl;
+      std::cout << "Delay sum: " << i->second.delaySum.GetMilliSeconds() << "ms" << std::endl;
+      std::cout << "Mean delay: " << (i->second.delaySum.GetSeconds() / i->second.rxPackets) * 1000 << "ms" << std::endl;
+
+      // gnuplot Delay
+      // Delay = (i->second.delaySum.GetSeconds() / i->second.rxPackets) * 1000;
+      // DataRate = i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds()) / 1024;
+
+      // dataset_delay.Add((double) i->first, (double) Delay);
+      // dataset_rate.Add((double) i->first, (double) DataRate);
+      std::cout << "Jitter sum: " << i->second.jitterSum.GetMilliSeconds() << "ms" << std::endl;
+      std::cout << "Mean jitter: " << (i->second.jitterSum.GetSeconds() / (i->second.rxPackets - 1)) * 1000 << "ms" << std::endl;
+      std::cout << "Lost Packets: " << i->second.txPackets - i->second.rxPackets << std::endl;
+      std::cout << "Packet loss: " << (((i->second.txPackets - i->second.rxPackets) * 1.0) / i->second.txPackets) * 100 << "%" << std::endl;
+      std::cout << "------------------------------------------------" << std::endl;
+
+  }
+}
+
 int
 main (int argc, char *argv[])
 {
   Time simTime = Minutes(2);
   uint64_t ues_to_consider = 0;
 
-  uint8_t worker = 0;
+  uint32_t worker = 0;
   int seed = 1;
   std::string simName = "test";
+  std::string statsFile = "";
+  std::string snapshotVariants = "";
+  bool flowMonitor = true;
+  bool autoWarmup = false;
+  Time checkInterval = Seconds (1);
+  uint32_t batchSize = 10;
+  uint32_t minBatches = 10;
+  double ciTarget = 0.05;
+  Time drainTime = Seconds (30);
+  bool lazyUes = false;
+  Time lazyLeadTime = Seconds (1);
+  bool stopWhenDone = false;
+  bool sharedEchoServer = false;
+  bool pathlossCache = false;
+  bool rotatingPcap = false;
+  RotatingPcapSink::Options pcapOptions;
+  uint32_t pcapMaxFileMb = 0;
+  bool animation = true;
+  bool animPackets = true;
+  uint64_t animMaxPktsPerFile = 100000;
+  Time animPollInterval = Seconds (0.25);
   double cellsize = 1000; // in meters
   uint16_t num_ues_app_a = 1;
   uint16_t num_ues_app_b = 2;
@@ -81,13 +1650,48 @@ main (int argc, char *argv[])
   cmd.AddValue ("numUeAppC", "Number of UEs for Application C",num_ues_app_c);
   cmd.AddValue ("ciot", "Cellular IoT Optimization",ciot);
   cmd.AddValue ("edt", "Early Data Transmission",edt);
+  cmd.AddValue ("statsFile", "If set, write the windowed statistics of the considered UEs as CSV to this file (used by nb-iot-campaign)", statsFile);
+  cmd.AddValue ("snapshotVariants", "Simulate the Pre-Run once and fork one child per comma separated <ciot><edt> variant, e.g. 11,10,01,00", snapshotVariants);
+  cmd.AddValue ("flowMonitor", "Additionally track the flows of all phases with the FlowMonitor", flowMonitor);
+  cmd.AddValue ("autoWarmup", "Detect the end of the warm-up online (MSER-5) and stop once the completion time CI is tight enough; 3*simTime becomes the upper bound", autoWarmup);
+  cmd.AddValue ("checkInterval", "autoWarmup: channel occupancy sampling interval", checkInterval);
+  cmd.AddValue ("batchSize", "autoWarmup: completion times per batch", batchSize);
+  cmd.AddValue ("minBatches", "autoWarmup: minimum number of batches before stopping", minBatches);
+  cmd.AddValue ("ciTarget", "autoWarmup: relative half-width of the 95% confidence interval to stop at", ciTarget);
+  cmd.AddValue ("drainTime", "autoWarmup: time to let the measured exchanges complete after stopping", drainTime);
+  cmd.AddValue ("lazyUes", "Create UE stacks only shortly before their access time and reuse them once they are idle again; disables the FlowMonitor", lazyUes);
+  cmd.AddValue ("lazyLeadTime", "lazyUes: how long before its access a device gets its UE stack", lazyLeadTime);
+  cmd.AddValue ("sharedEchoServer", "Serve all UEs with one echo server socket instead of one server and port per UE", sharedEchoServer);
+  cmd.AddValue ("pathlossCache", "Compute the Winner+ pathloss once per eNB/UE link (CachedPropagationLossModel) instead of for every transmission", pathlossCache);
+  cmd.AddValue ("stopWhenDone", "End the run as soon as all exchanges of the evaluated window have completed and their UEs have left RRC connected; the RRC/MAC logs of the other UEs end there", stopWhenDone);
+  cmd.AddValue ("animation", "Write the NetAnim trace", animation);
+  cmd.AddValue ("animPackets", "animation: include the packet events, otherwise only nodes and positions", animPackets);
+  cmd.AddValue ("animMaxPktsPerFile", "animation: packets per trace file before the next file is started", animMaxPktsPerFile);
+  cmd.AddValue ("animPollInterval", "animation: interval between two position samples of the mobile nodes", animPollInterval);
+  cmd.AddValue ("rotatingPcap", "Capture the point-to-point links with RotatingPcapSink instead of full EnablePcapAll traces", rotatingPcap);
+  cmd.AddValue ("pcapSnapLen", "rotatingPcap: bytes kept of every packet, 0 keeps them whole", pcapOptions.snapLen);
+  cmd.AddValue ("pcapMaxFileMb", "rotatingPcap: start a new capture file after this many MB, 0 never", pcapMaxFileMb);
+  cmd.AddValue ("pcapMaxFileTime", "rotatingPcap: start a new capture file after this much simulation time, 0 never", pcapOptions.maxFileTime);
+  cmd.AddValue ("pcapCompress", "rotatingPcap: gzip the capture files", pcapOptions.compress);
+  cmd.AddValue ("pcapFilter", "rotatingPcap: keep only matching packets, e.g. src=7.0.0.2,proto=17,dport=2001", pcapOptions.filter);
   
   // parse again so you can override default values from the command line
   cmd.Parse (argc, argv);
   ConfigStore inputConfig;
   inputConfig.ConfigureDefaults ();
+  if (autoWarmup && !snapshotVariants.empty ())
+    {
+      std::cerr << "autoWarmup and snapshotVariants can't be combined" << std::endl;
+      return 1;
+    }
+  if (lazyUes && flowMonitor)
+    {
+      // FlowMonitor probes can only be installed on the nodes that exist before the run
+      std::cout << "lazyUes: disabling the FlowMonitor" << std::endl;
+      flowMonitor = false;
+    }
 
-  LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
+  LogComponentEnable("LenaNb", LOG_LEVEL_INFO); // the echo clients
   LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
 
   Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
@@ -97,9 +1701,20 @@ main (int argc, char *argv[])
   lteHelper->SetEnbAntennaModelType ("ns3::IsotropicAntennaModel");
   lteHelper->SetUeAntennaModelType ("ns3::IsotropicAntennaModel");
   lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::WinnerPlusPropagationLossModel")); // Note that the Winner+ pathloss model isn't available in the current release of ns3. It can be downloaded at https://github.com/tudo-cni/ns3-propagation-winner-plus
-  lteHelper->SetPathlossModelAttribute ("HeightBasestation", DoubleValue (50));
-  lteHelper->SetPathlossModelAttribute ("Environment", EnumValue (UMaEnvironment));
-  lteHelper->SetPathlossModelAttribute ("LineOfSight", BooleanValue (false));
+  if (pathlossCache)
+    {
+      // the cache creates the Winner+ model itself, from the default attribute values
+      lteHelper->SetAttribute ("PathlossModel", StringValue ("ns3::CachedPropagationLossModel"));
+      Config::SetDefault ("ns3::WinnerPlusPropagationLossModel::HeightBasestation", DoubleValue (50));
+      Config::SetDefault ("ns3::WinnerPlusPropagationLossModel::Environment", EnumValue (UMaEnvironment));
+      Config::SetDefault ("ns3::WinnerPlusPropagationLossModel::LineOfSight", BooleanValue (false));
+    }
+  else
+    {
+      lteHelper->SetPathlossModelAttribute ("HeightBasestation", DoubleValue (50));
+      lteHelper->SetPathlossModelAttribute ("Environment", EnumValue (UMaEnvironment));
+      lteHelper->SetPathlossModelAttribute ("LineOfSight", BooleanValue (false));
+    }
   Config::SetDefault ("ns3::LteHelper::UseIdealRrc", BooleanValue (false));
   Config::SetDefault ("ns3::LteSpectrumPhy::CtrlErrorModelEnabled", BooleanValue (false));
   Config::SetDefault ("ns3::LteSpectrumPhy::DataErrorModelEnabled", BooleanValue (false));
@@ -155,8 +1770,12 @@ main (int argc, char *argv[])
   with more new transmissions to keep the channels busy and let the intermediate devices complete their transmissions.
   */
   NodeContainer ueNodes;
-  ueNodes.Create (ues_to_consider*3); // Pre-Run, Run, Post-Run.
+  if (!lazyUes)
+    {
+      ueNodes.Create (ues_to_consider*3); // Pre-Run, Run, Post-Run.
+    }
   Ptr<ListPositionAllocator> positionAllocUe = CreateObject<ListPositionAllocator> ();
+  std::vector<Vector> uePositions;
 
   for (uint32_t j = 0; j<3; j++){ // Pre-Run, Run, Post-Run.
     // Install Mobility Model for Application A
@@ -170,6 +1789,7 @@ main (int argc, char *argv[])
     for (uint32_t i = 0; i < num_ues_app_a; ++i){
       Vector position = m_position->GetNext ();
       positionAllocUe->Add (position);
+      uePositions.push_back (position);
       //std::cout << "a," << position.x << "," << position.y << "," << position.z << std::endl;
     }
     // Install Mobility Model for Application B
@@ -183,6 +1803,7 @@ main (int argc, char *argv[])
     for (uint32_t i = 0; i < num_ues_app_b; ++i){
       Vector position = m_position->GetNext ();
       positionAllocUe->Add (position);
+      uePositions.push_back (position);
       //std::cout << "b," << position.x << "," << position.y << "," << position.z << std::endl;
     }
     // Install Mobility Model for Application C
@@ -196,6 +1817,7 @@ main (int argc, char *argv[])
     for (uint32_t i = 0; i < num_ues_app_c; ++i){
       Vector position = m_position->GetNext ();
       positionAllocUe->Add (position);
+      uePositions.push_back (position);
       //std::cout << "c," << position.x << "," << position.y << "," << position.z << std::endl;
     }
   }
@@ -210,6 +1832,11 @@ main (int argc, char *argv[])
   // Install LTE Devices to the nodes
   NetDeviceContainer enbLteDevs = lteHelper->InstallEnbDevice (enbNodes);
   NetDeviceContainer ueLteDevs = lteHelper->InstallUeDevice (ueNodes);
+  if (pathlossCache)
+    {
+      // the UEs created later by lazyUes are computed on their first transmission
+      CachedPropagationLossModel::PrecomputeAll (enbNodes, ueNodes);
+    }
 
   // Install the IP stack on the UEs
   internet.Install (ueNodes);
@@ -231,206 +1858,109 @@ main (int argc, char *argv[])
   uint16_t ulPort = 2000;
   ApplicationContainer clientApps;
   ApplicationContainer serverApps;
-  
-  
-  // Set up the data transmission for the Pre-Run
-  for (uint16_t i = 0; i < ues_to_consider; i++)
+  // Only the intermediate X minutes are evaluated, see above. The accesses of these UEs are whole
+  // milliseconds drawn from [X, 2X] and the window excludes its end, so it closes 1 ms after 2X.
+  Ptr<WindowedFlowStats> windowedStats = Create<WindowedFlowStats> (simTime, 2*simTime + MilliSeconds (1));
+  // With autoWarmup, the window is opened by the detector and every UE may fall into it
+  Ptr<SteadyStateDetector> detector;
+  if (autoWarmup)
     {
-      int access = RaUeUniformVariable->GetInteger (50, simTime.GetMilliSeconds());
-      lteHelper->AttachSuspendedNb(ueLteDevs.Get(i), enbLteDevs.Get(0));
-
-      Ptr<LteUeNetDevice> ueLteDevice = ueLteDevs.Get(i)->GetObject<LteUeNetDevice> ();
-      Ptr<LteUeRrc> ueRrc = ueLteDevice->GetRrc();
-      if(ciot == true){
-        //std::cout << "ciot" << std::endl;
-        ueRrc->SetAttribute("CIoT-Opt", BooleanValue(true));
-      }
-      else{
-        ueRrc->SetAttribute("CIoT-Opt", BooleanValue(false));
-      }
-      if(edt == true){
-        //std::cout << "EDT" << std::endl;
-        ueRrc->SetAttribute("EDT", BooleanValue(true));
-      }
-      else{
-        ueRrc->SetAttribute("EDT", BooleanValue(false));
-      }
-
-      ++ulPort;
-      UdpEchoServerHelper server (ulPort);
-      serverApps.Add(server.Install (remoteHost));
-      //
-      // Create a UdpEchoClient application to send UDP datagrams from node zero to
-      // node one.
-      //
-      if (i < num_ues_app_a){
-        uint packetsize = packetsize_app_a;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_a));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
-      else if (i < num_ues_app_a+num_ues_app_b){
-        uint packetsize = packetsize_app_b;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_b));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
-      else {
-        uint packetsize = packetsize_app_c;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_c));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
+      windowedStats->SetWindow (3*simTime, 3*simTime);
+      detector = Create<SteadyStateDetector> (windowedStats, checkInterval, batchSize, minBatches, ciTarget, drainTime);
     }
-
-
-  // Set up the data transmission for the UEs to be considered in the results
-  for (uint16_t i = ues_to_consider; i < ues_to_consider*2; i++)
+  // The cell idles through the rest of the Post-Run once the evaluated exchanges are done, don't simulate that
+  if (stopWhenDone)
     {
-      int access = RaUeUniformVariable->GetInteger (simTime.GetMilliSeconds(), 2*simTime.GetMilliSeconds());
-      lteHelper->AttachSuspendedNb(ueLteDevs.Get(i), enbLteDevs.Get(0));
-
-      Ptr<LteUeNetDevice> ueLteDevice = ueLteDevs.Get(i)->GetObject<LteUeNetDevice> ();
-      Ptr<LteUeRrc> ueRrc = ueLteDevice->GetRrc();
-      ueRrc->EnableLogging();
-      if(ciot == true){
-        //std::cout << "ciot" << std::endl;
-        ueRrc->SetAttribute("CIoT-Opt", BooleanValue(true));
-      }
-      else{
-        ueRrc->SetAttribute("CIoT-Opt", BooleanValue(false));
-      }
-      if(edt == true){
-        //std::cout << "EDT" << std::endl;
-        ueRrc->SetAttribute("EDT", BooleanValue(true));
-      }
-      else{
-        ueRrc->SetAttribute("EDT", BooleanValue(false));
-      }
-
-      ++ulPort;
-      UdpEchoServerHelper server (ulPort);
-      serverApps.Add(server.Install (remoteHost));
-      //
-      // Create a UdpEchoClient application to send UDP datagrams from node zero to
-      // node one.
-      //
-
-      if (i < ues_to_consider+num_ues_app_a){
-        uint packetsize = packetsize_app_a;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_a));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
-      else if (i < ues_to_consider+num_ues_app_a+num_ues_app_b){
-        uint packetsize = packetsize_app_b;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_b));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
-      else {
-        uint packetsize = packetsize_app_c;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_c));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
+      windowedStats->StopWhenDone ();
     }
   
+  Ptr<MultiClientEchoServer> sharedServer;
+  if (sharedEchoServer)
+    {
+      sharedServer = CreateObject<MultiClientEchoServer> ();
+      sharedServer->SetAttribute ("Port", UintegerValue (ulPort));
+      remoteHost->AddApplication (sharedServer);
+      windowedStats->AddServer (sharedServer);
+    }
 
-
-  // Set up the data transmission for the Post-Run
-  for (uint16_t i = ues_to_consider*2; i < ues_to_consider*3; i++)
+  Ptr<UePopulation> population;
+  if (lazyUes)
     {
-      int access = RaUeUniformVariable->GetInteger (simTime.GetMilliSeconds()*2, simTime.GetMilliSeconds()*3);
-      lteHelper->AttachSuspendedNb(ueLteDevs.Get(i), enbLteDevs.Get(0));
+      population = Create<UePopulation> (lteHelper, epcHelper, enbLteDevs.Get(0), remoteHost, remoteHostAddr,
+                                         lazyLeadTime, 3*simTime);
+      population->SetRrcConfig (0, ciot, edt);
+      population->SetStats (windowedStats, autoWarmup, detector);
+      if (sharedEchoServer)
+        {
+          population->SetSharedServer (sharedServer, ulPort);
+        }
+    }
 
-      Ptr<LteUeNetDevice> ueLteDevice = ueLteDevs.Get(i)->GetObject<LteUeNetDevice> ();
-      Ptr<LteUeRrc> ueRrc = ueLteDevice->GetRrc();
-      if(ciot == true){
-        //std::cout << "ciot" << std::endl;
-        ueRrc->SetAttribute("CIoT-Opt", BooleanValue(true));
-      }
-      else{
-        ueRrc->SetAttribute("CIoT-Opt", BooleanValue(false));
-      }
-      if(edt == true){
-        //std::cout << "EDT" << std::endl;
-        ueRrc->SetAttribute("EDT", BooleanValue(true));
+  // Set up the data transmission for the Pre-Run (UEs [0, X)), the UEs to be considered in the
+  // results (UEs [X, 2X)) and the Post-Run (UEs [2X, 3X)). Within each phase, the first
+  // num_ues_app_a UEs run Application A, the next num_ues_app_b Application B, the rest Application C.
+  for (uint32_t i = 0; i < ues_to_consider*3; i++)
+    {
+      uint32_t phase = i / ues_to_consider;
+      uint32_t j = i % ues_to_consider;
+      int access = RaUeUniformVariable->GetInteger (phase == 0 ? 50 : phase*simTime.GetMilliSeconds(), (phase+1)*simTime.GetMilliSeconds());
+      uint packetsize = packetsize_app_c;
+      Time packetinterval = packetinterval_app_c;
+      if (j < num_ues_app_a){
+        packetsize = packetsize_app_a;
+        packetinterval = packetinterval_app_a;
       }
-      else{
-        ueRrc->SetAttribute("EDT", BooleanValue(false));
+      else if (j < num_ues_app_a+num_ues_app_b){
+        packetsize = packetsize_app_b;
+        packetinterval = packetinterval_app_b;
       }
+      // the shared server keeps the base port, so the population is not limited by the port space
+      if (!sharedEchoServer)
+        {
+          ++ulPort;
+        }
+      if (lazyUes)
+        {
+          population->Add (phase, MilliSeconds (access), uePositions[i], ulPort, packetsize, packetinterval);
+          continue;
+        }
 
-      ++ulPort;
-      UdpEchoServerHelper server (ulPort);
-      serverApps.Add(server.Install (remoteHost));
+      lteHelper->AttachSuspendedNb(ueLteDevs.Get(i), enbLteDevs.Get(0));
+      if (phase == 1)
+        {
+          ueLteDevs.Get(i)->GetObject<LteUeNetDevice> ()->GetRrc()->EnableLogging();
+        }
+      ConfigureUeRrc (ueLteDevs.Get(i), ciot, edt);
+
+      Ptr<Application> serverApp;
+      if (sharedEchoServer)
+        {
+          sharedServer->AddPeer (ueIpIface.GetAddress (i), MilliSeconds (access));
+        }
+      else
+        {
+          UdpEchoServerHelper server (ulPort);
+          serverApp = server.Install (remoteHost).Get (0);
+          serverApp->SetStartTime (MilliSeconds (access));
+          serverApps.Add (serverApp);
+        }
       //
-      // Create a UdpEchoClient application to send UDP datagrams from node zero to
-      // node one.
+      // Create an echo client to send UDP datagrams from the UE to the remote host. Unlike
+      // UdpEchoClient it numbers its requests, which WindowedFlowStats matches the replies with.
       //
-      if (i < ues_to_consider*2 + num_ues_app_a){
-        uint packetsize = packetsize_app_a;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_a));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
-      else if (i < ues_to_consider*2 + num_ues_app_a+num_ues_app_b){
-        uint packetsize = packetsize_app_b;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_b));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
-      else {
-        uint packetsize = packetsize_app_c;
-        UdpEchoClientHelper ulClient (remoteHostAddr, ulPort);
-        ulClient.SetAttribute ("Interval", TimeValue (packetinterval_app_c));
-        ulClient.SetAttribute ("MaxPackets", UintegerValue (1000000));
-        ulClient.SetAttribute ("PacketSize", UintegerValue(packetsize));
-        clientApps.Add (ulClient.Install (ueNodes.Get(i)));
-
-        serverApps.Get(i)->SetStartTime (MilliSeconds (access));
-        clientApps.Get(i)->SetStartTime (MilliSeconds (access));
-      }
+      Ptr<ReusableEchoClient> ulClient = CreateObject<ReusableEchoClient> ();
+      ueNodes.Get(i)->AddApplication (ulClient);
+      ulClient->Start (remoteHostAddr, ulPort, packetsize, packetinterval, MilliSeconds (access));
+      clientApps.Add (ulClient);
+      if (phase == 1 || autoWarmup)
+        {
+          windowedStats->Add (ueIpIface.GetAddress (i), clientApps.Get(i), serverApp,
+                              ueLteDevs.Get(i)->GetObject<LteUeNetDevice> ()->GetRrc ());
+        }
+      if (autoWarmup)
+        {
+          detector->Add (clientApps.Get(i));
+        }
     }
 
 
@@ -439,110 +1969,168 @@ main (int argc, char *argv[])
   auto start = std::chrono::system_clock::now(); 
   std::time_t start_time = std::chrono::system_clock::to_time_t(start);
   std::cout << "started computation at " << std::ctime(&start_time);
-  std::string logdir = "logs/";
-  std::string makedir = "mkdir -p ";
-  std::string techdir = makedir;
-
-  techdir += logdir;
-  int z = std::system(techdir.c_str());
-  //std::cout << z;
-  techdir += "/";
-  techdir += simName;
-  techdir += "/";
-  z = std::system(techdir.c_str());
-  std::cout << z;
-  logdir += simName;
-  logdir += "/";
-  logdir += std::to_string(ueNodes.GetN());
-  logdir += "_";
-  logdir += std::to_string(std::round(simTime.GetSeconds()));
-  logdir += "_";
-  logdir += std::to_string(ciot);
-  logdir += "_";
-  logdir += std::to_string(edt);
-  
-  std::string top_dirmakedir = makedir+logdir; 
-  int a = std::system(top_dirmakedir.c_str());
-  std::cout << a << std::endl;
-  logdir += "/";
-  
-  auto tm = *std::localtime(&start_time);
-  std::stringstream ss;
-  ss << std::put_time(&tm, "%d_%m_%Y_%H_%M_%S");
-  logdir += ss.str();
-  logdir += "_";
-  logdir += std::to_string(worker);
-  logdir += "_";
-  logdir += std::to_string(seed);
-  logdir += "_";  
-
-  for (uint16_t i = 0; i < ueNodes.GetN(); i++){
-
-    Ptr<LteUeNetDevice> ueLteDevice = ueLteDevs.Get(i)->GetObject<LteUeNetDevice> ();
-    Ptr<LteUeRrc> ueRrc = ueLteDevice->GetRrc();
-    Ptr<LteUeMac> ueMac = ueLteDevice->GetMac();
-    ueRrc->SetLogDir(logdir);
-    ueMac->SetLogDir(logdir); 
-
-      }
-  Ptr<LteEnbNetDevice> enbLteDevice = enbLteDevs.Get(0)->GetObject<LteEnbNetDevice>();
-  Ptr<LteEnbRrc> enbRrc = enbLteDevice->GetRrc();
-  enbRrc->SetLogDir(logdir);
+  std::string logdir = SetupLogDir (simName, ues_to_consider*3, simTime, ciot, edt, start_time, worker, seed);
+  SetLogDirs (ueLteDevs, 0, ueNodes.GetN(), enbLteDevs.Get(0), logdir);
+  if (lazyUes)
+    {
+      population->SetLogDir (logdir);
+    }
   
   
   //lteHelper->EnableTraces ();
   // Uncomment to enable PCAP tracing
-  p2ph.EnablePcapAll("nb-iot");
+  // Forked snapshot children would share the open capture files, so PCAP tracing is off in that mode.
+  std::vector<Ptr<RotatingPcapSink> > pcapSinks;
+  if (snapshotVariants.empty () && rotatingPcap)
+    {
+      pcapOptions.maxFileBytes = uint64_t (pcapMaxFileMb) << 20;
+      pcapSinks = EnableRotatingPcapAll ("nb-iot", pcapOptions);
+    }
+  else if (snapshotVariants.empty ())
+    {
+      p2ph.EnablePcapAll("nb-iot");
+    }
 
   Ptr <FlowMonitor> monitor; // = flowMonHelper.InstallAll();
   FlowMonitorHelper flowMonHelper;
-  monitor = flowMonHelper.Install(enbNodes);
-  monitor = flowMonHelper.Install(ueNodes);
-  monitor = flowMonHelper.Install(remoteHost);
+  if (flowMonitor)
+    {
+      monitor = flowMonHelper.Install(enbNodes);
+      monitor = flowMonHelper.Install(ueNodes);
+      monitor = flowMonHelper.Install(remoteHost);
+    }
   
+  if (!snapshotVariants.empty ())
+    {
+      /*
+      Snapshot mode: the Pre-Run is simulated once. At t = X the process forks one copy-on-write child per
+      variant "<ciot><edt>"; each child applies its CIoT-Opt/EDT setting to the considered and Post-Run UEs,
+      none of which has started yet, and simulates the remaining 2*X on its own. All variants thus evaluate
+      the same warm-up state.
+      */
+      std::vector<std::string> variants;
+      std::stringstream vs (snapshotVariants);
+      std::string variant;
+      while (std::getline (vs, variant, ','))
+        {
+          if (variant.size () != 2 || variant.find_first_not_of ("01") != std::string::npos)
+            {
+              std::cerr << "Invalid snapshot variant " << variant << ", expected <ciot><edt>, e.g. 10" << std::endl;
+              return 1;
+            }
+          variants.push_back (variant);
+        }
+
+      Simulator::Stop (simTime); // Pre-Run
+      Simulator::Run ();
+      std::cout << "pre-run finished at " << Simulator::Now ().GetSeconds () << "s, forking " << variants.size () << " variants" << std::endl;
+      std::cout.flush ();
+
+      std::vector<pid_t> children;
+      for (const std::string &v : variants)
+        {
+          pid_t pid = fork ();
+          if (pid < 0)
+            {
+              std::cerr << "fork failed for variant " << v << std::endl;
+              continue;
+            }
+          if (pid > 0)
+            {
+              children.push_back (pid);
+              continue;
+            }
+
+          // child: evaluate this variant
+          bool variantCiot = v[0] == '1';
+          bool variantEdt = v[1] == '1';
+          std::string variantLogdir = SetupLogDir (simName, ues_to_consider*3, simTime, variantCiot, variantEdt, start_time, worker, seed);
+          if (lazyUes)
+            {
+              population->SetRrcConfig (1, variantCiot, variantEdt);
+              population->SetLogDir (variantLogdir);
+            }
+          else
+            {
+              for (uint32_t i = ues_to_consider; i < ues_to_consider*3; i++)
+                {
+                  ConfigureUeRrc (ueLteDevs.Get(i), variantCiot, variantEdt);
+                }
+              SetLogDirs (ueLteDevs, ues_to_consider, ueNodes.GetN(), enbLteDevs.Get(0), variantLogdir);
+            }
+
+          Simulator::Stop (2*simTime); // Run, Post-Run
+          Simulator::Run ();
+
+          std::cout << std::endl << "*** Variant ciot=" << variantCiot << " edt=" << variantEdt << " ***" << std::endl;
+          if (flowMonitor)
+            {
+              ReportFlowStats (monitor, flowMonHelper, "nb-iot-" + v + ".flowmon");
+            }
+          bool ok = windowedStats->Report (statsFile.empty () ? statsFile : statsFile + "." + v, worker, seed);
+          std::cout.flush ();
+          Simulator::Destroy ();
+          _exit (ok ? 0 : 1);
+        }
+
+      int failed = children.size () == variants.size () ? 0 : 1;
+      for (pid_t child : children)
+        {
+          int status;
+          waitpid (child, &status, 0);
+          if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+            {
+              failed = 1;
+            }
+        }
+      auto end = std::chrono::system_clock::now();
+      std::chrono::duration<double> elapsed_seconds = end-start;
+      std::cout << "elapsed time: " << elapsed_seconds.count() << "s\n";
+      Simulator::Destroy ();
+      return failed;
+    }
+
   Simulator::Stop (3*simTime); // Pre-Run, Run, Post-Run
+  if (autoWarmup)
+    {
+      detector->Start ();
+    }
   
-  AnimationInterface animation("nb-iot.xml");
-  animation.UpdateNodeDescription(pgw, "PGW");
-  animation.UpdateNodeDescription(remoteHost, "RemoteHost");
+  std::unique_ptr<AnimationInterface> anim;
+  if (animation)
+    {
+      anim.reset (new AnimationInterface ("nb-iot.xml"));
+      anim->SetMaxPktsPerTraceFile (animMaxPktsPerFile);
+      NS_ABORT_MSG_IF (!animPollInterval.IsStrictlyPositive (), "animPollInterval must be positive");
+      anim->SetMobilityPollInterval (animPollInterval);
+      if (!animPackets)
+        {
+          anim->SkipPacketTracing ();
+        }
+      anim->UpdateNodeDescription(pgw, "PGW");
+      anim->UpdateNodeDescription(remoteHost, "RemoteHost");
+    }
   
   Simulator::Run ();
+  for (Ptr<RotatingPcapSink> sink : pcapSinks)
+    {
+      sink->Close ();
+    }
 
-  monitor->CheckForLostPackets();
-  Ptr <Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowMonHelper.GetClassifier());
-  std::map <FlowId, FlowMonitor::FlowStats> stats = monitor->GetFlowStats();
-
-  monitor->SerializeToXmlFile("nb-iot.flowmon", true, true);
-
-  std::cout << std::endl << "*** Flow monitor statistic ***" << std::endl;
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin(); i != stats.end(); ++i) {
-
-      // if (i-> first > 2) {
-      // double Delay, DataRate;
-      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(i->first);
-      std::cout << "Flow ID: " << i->first << std::endl;
-      std::cout << "Src add: " << t.sourceAddress << "-> Dst add: " << t.destinationAddress << std::endl;
-      std::cout << "Src port: " << t.sourcePort << "-> Dst port: " << t.destinationPort << std::endl;
-      std::cout << "Tx Packets/Bytes: " << i->second.txPackets << "/" << i->second.txBytes << std::endl;
-      std::cout << "Rx Packets/Bytes: " << i->second.rxPackets << "/" << i->second.rxBytes << std::endl;
-      std::cout << "Throughput: " << i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds()) / 1024 << "kb/s" << std::endl;
-      std::cout << "Delay sum: " << i->second.delaySum.GetMilliSeconds() << "ms" << std::endl;
-      std::cout << "Mean delay: " << (i->second.delaySum.GetSeconds() / i->second.rxPackets) * 1000 << "ms" << std::endl;
-
-      // gnuplot Delay
-      // Delay = (i->second.delaySum.GetSeconds() / i->second.rxPackets) * 1000;
-      // DataRate = i->second.rxBytes * 8.0 / (i->second.timeLastRxPacket.GetSeconds() - i->second.timeFirstTxPacket.GetSeconds()) / 1024;
-
-      // dataset_delay.Add((double) i->first, (double) Delay);
-      // dataset_rate.Add((double) i->first, (double) DataRate);
-      std::cout << "Jitter sum: " << i->second.jitterSum.GetMilliSeconds() << "ms" << std::endl;
-      std::cout << "Mean jitter: " << (i->second.jitterSum.GetSeconds() / (i->second.rxPackets - 1)) * 1000 << "ms" << std::endl;
-      std::cout << "Lost Packets: " << i->second.txPackets - i->second.rxPackets << std::endl;
-      std::cout << "Packet loss: " << (((i->second.txPackets - i->second.rxPackets) * 1.0) / i->second.txPackets) * 100 << "%" << std::endl;
-      std::cout << "------------------------------------------------" << std::endl;
-
-  }
+  if (flowMonitor)
+    {
+      ReportFlowStats (monitor, flowMonHelper, "nb-iot.flowmon");
+    }
+  if (!windowedStats->Report (statsFile, worker, seed))
+    {
+      return 1;
+    }
 
+  if (lazyUes)
+    {
+      std::cout << "lazyUes: " << population->GetNDevices () << " devices served by "
+                << population->GetNStacks () << " UE stacks" << std::endl;
+    }
 
   auto end = std::chrono::system_clock::now();
   std::chrono::duration<double> elapsed_seconds = end-start;
@@ -552,4 +2140,3 @@ main (int argc, char *argv[])
   Simulator::Destroy ();
   return 0;
 }
-
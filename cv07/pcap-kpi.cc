@@ -0,0 +1,793 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/**
+ * Offline KPI analyzer for the pcap files written by the scenarios
+ * (p2ph.EnablePcapAll, csma/wifi EnablePcap).
+ *
+ * Every capture is mmap'ed and parsed in place; .pcap.gz captures, as written by
+ * RotatingPcapSink, are streamed through "gzip -dc" instead. Supported link types: Ethernet,
+ * PPP (point-to-point devices), radiotap + 802.11 + LLC/SNAP (wifi devices),
+ * Linux cooked and raw IPv4. Inside IPv4, UDP and TCP are decoded, and
+ * GTP-U (UDP port 2152, the S1-U captures of the EPC scenarios) is unwrapped
+ * so the KPIs are reported for the inner flow.
+ *
+ * For every five-tuple of every file one CSV line is written: packets and IP
+ * bytes, throughput over the lifetime of the flow, inter-arrival mean, standard
+ * deviation and maximum. For UDP flows whose payload starts with a SeqTsHeader
+ * (UdpClient traffic) the sequence numbers give the lost and reordered packets
+ * and the timestamps the mean one-way delay up to the capture point. The header
+ * is looked for on the --seqPorts ports, by default on every UDP port but the
+ * GTP-C one; a flow whose timestamps lie after the capture time or don't
+ * follow the sequence numbers is not UdpClient traffic and gets these columns
+ * empty. Files are spread over --threads threads; directories are searched
+ * recursively for *.pcap and *.pcap.gz.
+ *
+ * This is a plain POSIX program, it does not link against ns-3:
+ *
+ * \code{.unparsed}
+$ g++ -O2 -std=c++17 -pthread -o pcap-kpi pcap-kpi.cc
+$ ./pcap-kpi --threads=16 --out=kpi.csv --seqPorts=1234 campaign/
+    \endcode
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+const uint16_t GTPU_PORT = 2152;
+const uint16_t GTPC_PORT = 2123;
+
+// UDP ports carrying a SeqTsHeader, empty for all but GTP-C; set once before the threads start
+std::unordered_set<uint16_t> g_seqPorts;
+
+struct FiveTuple
+{
+  uint32_t src;
+  uint32_t dst;
+  uint16_t srcPort;
+  uint16_t dstPort;
+  uint8_t protocol;
+  uint32_t teid; // GTP-U tunnel of the inner packet, 0 if not tunnelled
+
+  bool operator== (const FiveTuple &o) const
+  {
+    return src == o.src && dst == o.dst && srcPort == o.srcPort && dstPort == o.dstPort
+           && protocol == o.protocol && teid == o.teid;
+  }
+};
+
+struct FiveTupleHash
+{
+  size_t operator() (const FiveTuple &t) const
+  {
+    uint64_t h = (uint64_t (t.src) << 32 | t.dst) * 0x9e3779b97f4a7c15ull;
+    h ^= (uint64_t (t.srcPort) << 24 | uint64_t (t.dstPort) << 8 | t.protocol) + (uint64_t (t.teid) << 40);
+    return h ^ (h >> 29);
+  }
+};
+
+struct FlowKpi
+{
+  uint64_t packets = 0;
+  uint64_t bytes = 0;
+  int64_t first = 0; // ns
+  int64_t last = 0;
+  // inter-arrival times, Welford
+  double iatMean = 0;
+  double iatM2 = 0;
+  int64_t iatMax = 0;
+  // SeqTsHeader
+  uint64_t seqPackets = 0;
+  uint32_t seqMin = UINT32_MAX;
+  uint32_t seqMax = 0;
+  uint32_t seqLast = 0;
+  int64_t tsLast = 0;
+  bool seqValid = true;
+  uint64_t reordered = 0;
+  double delaySum = 0; // ns
+};
+
+struct FileResult
+{
+  std::string file;
+  std::string error;
+  uint64_t records = 0;
+  uint64_t skipped = 0; // not IPv4 or truncated
+  std::vector<std::pair<FiveTuple, FlowKpi> > flows;
+};
+
+inline uint16_t
+Be16 (const uint8_t *p)
+{
+  return uint16_t (p[0] << 8 | p[1]);
+}
+
+inline uint32_t
+Be32 (const uint8_t *p)
+{
+  return uint32_t (p[0]) << 24 | uint32_t (p[1]) << 16 | uint32_t (p[2]) << 8 | p[3];
+}
+
+std::string
+FormatAddress (uint32_t a)
+{
+  return std::to_string (a >> 24) + "." + std::to_string ((a >> 16) & 0xff) + "."
+         + std::to_string ((a >> 8) & 0xff) + "." + std::to_string (a & 0xff);
+}
+
+// Strips the link layer, returns the IPv4 header or nullptr.
+const uint8_t *
+LinkToIpv4 (uint32_t linkType, const uint8_t *p, uint32_t &n)
+{
+  uint16_t etherType = 0x0800;
+  switch (linkType)
+    {
+    case 1: // Ethernet
+      if (n < 14)
+        {
+          return nullptr;
+        }
+      etherType = Be16 (p + 12);
+      p += 14;
+      n -= 14;
+      while (etherType == 0x8100 && n >= 4)
+        {
+          etherType = Be16 (p + 2);
+          p += 4;
+          n -= 4;
+        }
+      break;
+    case 9: // PPP
+      if (n >= 4 && p[0] == 0xff && p[1] == 0x03)
+        {
+          p += 2;
+          n -= 2;
+        }
+      if (n < 2)
+        {
+          return nullptr;
+        }
+      etherType = Be16 (p) == 0x0021 ? 0x0800 : 0;
+      p += 2;
+      n -= 2;
+      break;
+    case 113: // Linux cooked
+      if (n < 16)
+        {
+          return nullptr;
+        }
+      etherType = Be16 (p + 14);
+      p += 16;
+      n -= 16;
+      break;
+    case 127: // radiotap, little endian length at offset 2
+      {
+        if (n < 4)
+          {
+            return nullptr;
+          }
+        uint32_t len = p[2] | p[3] << 8;
+        if (n < len)
+          {
+            return nullptr;
+          }
+        p += len;
+        n -= len;
+      }
+      // fall through
+    case 105: // 802.11
+      {
+        if (n < 24)
+          {
+            return nullptr;
+          }
+        uint8_t fc0 = p[0];
+        uint8_t fc1 = p[1];
+        if (((fc0 >> 2) & 0x3) != 2 || (fc0 & 0x40) || (fc1 & 0x40))
+          {
+            return nullptr; // not data, null data or protected
+          }
+        uint32_t header = 24;
+        if ((fc1 & 0x3) == 0x3)
+          {
+            header += 6; // four addresses
+          }
+        if (fc0 & 0x80)
+          {
+            header += 2; // QoS control
+          }
+        if (n < header + 8 || p[header] != 0xaa || p[header + 1] != 0xaa)
+          {
+            return nullptr;
+          }
+        etherType = Be16 (p + header + 6); // LLC/SNAP
+        p += header + 8;
+        n -= header + 8;
+      }
+      break;
+    case 12:
+    case 101:
+    case 228: // raw IPv4
+      break;
+    default:
+      return nullptr;
+    }
+  if (etherType != 0x0800 || n < 20 || (p[0] >> 4) != 4)
+    {
+      return nullptr;
+    }
+  return p;
+}
+
+/*
+ * Fills the five-tuple of the IPv4 packet at p; returns the transport payload
+ * (possibly nullptr) and its captured length in payloadLen. If the packet is a
+ * GTP-U one, the inner packet is decoded instead.
+ */
+bool
+DecodeIpv4 (const uint8_t *p, uint32_t n, FiveTuple &t, uint32_t &ipBytes,
+            const uint8_t *&payload, uint32_t &payloadLen, int depth = 0)
+{
+  uint32_t ihl = (p[0] & 0x0f) * 4;
+  if (ihl < 20 || n < ihl)
+    {
+      return false;
+    }
+  ipBytes = Be16 (p + 2);
+  t.protocol = p[9];
+  t.src = Be32 (p + 12);
+  t.dst = Be32 (p + 16);
+  t.srcPort = 0;
+  t.dstPort = 0;
+  payload = nullptr;
+  payloadLen = 0;
+  if ((Be16 (p + 6) & 0x1fff) != 0)
+    {
+      return true; // non-first fragment, no transport header
+    }
+  const uint8_t *l4 = p + ihl;
+  uint32_t l4n = std::min (n, ipBytes) > ihl ? std::min (n, ipBytes) - ihl : 0;
+  if (t.protocol == 17 && l4n >= 8)
+    {
+      t.srcPort = Be16 (l4);
+      t.dstPort = Be16 (l4 + 2);
+      payload = l4 + 8;
+      payloadLen = l4n - 8;
+      if (depth == 0 && (t.dstPort == GTPU_PORT || t.srcPort == GTPU_PORT) && payloadLen >= 8
+          && (payload[0] >> 5) == 1 && payload[1] == 0xff) // version 1, G-PDU
+        {
+          uint32_t teid = Be32 (payload + 4);
+          uint32_t header = 8;
+          if (payload[0] & 0x07)
+            {
+              header = 12; // sequence number, N-PDU number, next extension
+              uint8_t next = payloadLen >= 12 ? payload[11] : 0;
+              while (next != 0 && payloadLen >= header + 4)
+                {
+                  uint32_t len = payload[header] * 4;
+                  if (len == 0 || payloadLen < header + len)
+                    {
+                      return false;
+                    }
+                  next = payload[header + len - 1];
+                  header += len;
+                }
+            }
+          if (payloadLen >= header + 20 && (payload[header] >> 4) == 4)
+            {
+              bool ok = DecodeIpv4 (payload + header, payloadLen - header, t, ipBytes, payload,
+                                    payloadLen, depth + 1);
+              t.teid = teid;
+              return ok;
+            }
+        }
+    }
+  else if (t.protocol == 6 && l4n >= 20)
+    {
+      t.srcPort = Be16 (l4);
+      t.dstPort = Be16 (l4 + 2);
+      uint32_t dataOffset = (l4[12] >> 4) * 4;
+      if (dataOffset <= l4n)
+        {
+          payload = l4 + dataOffset;
+          payloadLen = l4n - dataOffset;
+        }
+    }
+  return true;
+}
+
+void
+Account (FlowKpi &k, int64_t ns, uint32_t ipBytes, const FiveTuple &t, const uint8_t *payload,
+         uint32_t payloadLen)
+{
+  if (k.packets == 0)
+    {
+      k.first = ns;
+    }
+  else
+    {
+      int64_t iat = ns - k.last;
+      double delta = iat - k.iatMean;
+      k.iatMean += delta / k.packets; // k.packets - 1 inter-arrivals before this one
+      k.iatM2 += delta * (iat - k.iatMean);
+      k.iatMax = std::max (k.iatMax, iat);
+    }
+  k.last = ns;
+  k.packets++;
+  k.bytes += ipBytes;
+
+  // SeqTsHeader: 32 bit sequence number, 64 bit send time in ns-3 time steps (ns)
+  bool seqPort = g_seqPorts.empty () ? t.srcPort != GTPC_PORT && t.dstPort != GTPC_PORT
+                                     : g_seqPorts.count (t.dstPort) > 0;
+  if (t.protocol == 17 && payloadLen >= 12 && seqPort && k.seqValid)
+    {
+      uint32_t seq = Be32 (payload);
+      int64_t ts = int64_t (uint64_t (Be32 (payload + 4)) << 32 | Be32 (payload + 8));
+      // a packet can't be captured before it was sent, and the send times grow with the sequence numbers
+      if (ts < 0 || ts > ns
+          || (k.seqPackets > 0 && ((seq > k.seqLast && ts < k.tsLast) || (seq < k.seqLast && ts > k.tsLast))))
+        {
+          k.seqValid = false;
+          return;
+        }
+      if (k.seqPackets > 0 && seq < k.seqLast)
+        {
+          k.reordered++;
+        }
+      k.seqLast = seq;
+      k.tsLast = ts;
+      k.seqMin = std::min (k.seqMin, seq);
+      k.seqMax = std::max (k.seqMax, seq);
+      k.seqPackets++;
+      k.delaySum += double (ns - ts);
+    }
+}
+
+struct PcapFormat
+{
+  bool swapped;
+  bool nanosecond;
+  uint32_t linkType;
+
+  uint32_t Field (const uint8_t *p) const
+  {
+    uint32_t v;
+    std::memcpy (&v, p, 4);
+    return swapped ? __builtin_bswap32 (v) : v;
+  }
+};
+
+typedef std::unordered_map<FiveTuple, FlowKpi, FiveTupleHash> FlowTable;
+
+// Reads the 24 byte global header.
+bool
+ParseHeader (const uint8_t *base, PcapFormat &format)
+{
+  uint32_t magic;
+  std::memcpy (&magic, base, 4);
+  format.swapped = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+  format.nanosecond = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+  if (!format.swapped && !format.nanosecond && magic != 0xa1b2c3d4)
+    {
+      return false;
+    }
+  format.linkType = format.Field (base + 20) & 0x0fffffff;
+  return true;
+}
+
+// Accounts the complete records in [base, base + size), returns the offset of the first incomplete one.
+size_t
+ParseRecords (const uint8_t *base, size_t size, const PcapFormat &format, FlowTable &flows, FileResult &result)
+{
+  size_t pos = 0;
+  while (pos + 16 <= size)
+    {
+      const uint8_t *rec = base + pos;
+      uint32_t inclLen = format.Field (rec + 8);
+      if (pos + 16 + inclLen > size)
+        {
+          break;
+        }
+      int64_t ns = int64_t (format.Field (rec)) * 1000000000
+                   + (format.nanosecond ? format.Field (rec + 4) : int64_t (format.Field (rec + 4)) * 1000);
+      pos += 16 + inclLen;
+      result.records++;
+
+      uint32_t n = inclLen;
+      const uint8_t *ip = LinkToIpv4 (format.linkType, rec + 16, n);
+      FiveTuple t{};
+      uint32_t ipBytes;
+      const uint8_t *payload;
+      uint32_t payloadLen;
+      if (ip == nullptr || !DecodeIpv4 (ip, n, t, ipBytes, payload, payloadLen))
+        {
+          result.skipped++;
+          continue;
+        }
+      Account (flows[t], ns, ipBytes, t, payload, payloadLen);
+    }
+  return pos;
+}
+
+void
+AnalyzeMapped (FileResult &result, FlowTable &flows)
+{
+  int fd = open (result.file.c_str (), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    {
+      result.error = strerror (errno);
+      return;
+    }
+  struct stat st;
+  if (fstat (fd, &st) != 0 || st.st_size < 24)
+    {
+      result.error = "too short for a pcap file";
+      close (fd);
+      return;
+    }
+  size_t size = st.st_size;
+  void *map = mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      result.error = strerror (errno);
+      return;
+    }
+  madvise (map, size, MADV_SEQUENTIAL);
+  const uint8_t *base = static_cast<const uint8_t *> (map);
+
+  PcapFormat format;
+  if (!ParseHeader (base, format))
+    {
+      result.error = "not a pcap file";
+      munmap (map, size);
+      return;
+    }
+  // a trailing incomplete record was cut by an interrupted run
+  ParseRecords (base + 24, size - 24, format, flows, result);
+  munmap (map, size);
+}
+
+// Streams a .pcap.gz through "gzip -dc", which reads the already opened file so no shell sees the name.
+void
+AnalyzeCompressed (FileResult &result, FlowTable &flows)
+{
+  int in = open (result.file.c_str (), O_RDONLY | O_CLOEXEC);
+  if (in < 0)
+    {
+      result.error = strerror (errno);
+      return;
+    }
+  int out[2];
+  if (pipe2 (out, O_CLOEXEC) != 0)
+    {
+      result.error = strerror (errno);
+      close (in);
+      return;
+    }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init (&actions);
+  posix_spawn_file_actions_adddup2 (&actions, in, 0);
+  posix_spawn_file_actions_adddup2 (&actions, out[1], 1);
+  char *argv[] = {const_cast<char *> ("gzip"), const_cast<char *> ("-dc"), nullptr};
+  pid_t gzip;
+  int error = posix_spawnp (&gzip, "gzip", &actions, nullptr, argv, environ);
+  posix_spawn_file_actions_destroy (&actions);
+  close (in);
+  close (out[1]);
+  if (error != 0)
+    {
+      result.error = std::string ("can't start gzip: ") + strerror (error);
+      close (out[0]);
+      return;
+    }
+
+  std::vector<uint8_t> buffer (4 << 20);
+  size_t filled = 0;
+  bool header = false;
+  PcapFormat format;
+  while (true)
+    {
+      if (filled == buffer.size ())
+        {
+          buffer.resize (buffer.size () * 2); // a record larger than the buffer
+        }
+      ssize_t n = read (out[0], buffer.data () + filled, buffer.size () - filled);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n <= 0)
+        {
+          break;
+        }
+      filled += n;
+      size_t pos = 0;
+      if (!header)
+        {
+          if (filled < 24)
+            {
+              continue;
+            }
+          if (!ParseHeader (buffer.data (), format))
+            {
+              result.error = "not a pcap file";
+              break;
+            }
+          header = true;
+          pos = 24;
+        }
+      pos += ParseRecords (buffer.data () + pos, filled - pos, format, flows, result);
+      std::memmove (buffer.data (), buffer.data () + pos, filled - pos);
+      filled -= pos;
+    }
+  close (out[0]);
+  int status;
+  waitpid (gzip, &status, 0);
+  if (result.error.empty () && !header)
+    {
+      result.error = "too short for a pcap file";
+    }
+  else if (result.error.empty () && (!WIFEXITED (status) || WEXITSTATUS (status) != 0))
+    {
+      result.error = "gzip -dc failed"; // the flows read before the corruption are kept
+    }
+}
+
+bool
+IsCompressed (const std::string &name)
+{
+  return name.size () > 3 && name.compare (name.size () - 3, 3, ".gz") == 0;
+}
+
+void
+AnalyzeFile (FileResult &result)
+{
+  FlowTable flows;
+  if (IsCompressed (result.file))
+    {
+      AnalyzeCompressed (result, flows);
+    }
+  else
+    {
+      AnalyzeMapped (result, flows);
+    }
+
+  result.flows.assign (flows.begin (), flows.end ());
+  std::sort (result.flows.begin (), result.flows.end (),
+             [] (const std::pair<FiveTuple, FlowKpi> &a, const std::pair<FiveTuple, FlowKpi> &b) {
+               return a.second.first < b.second.first;
+             });
+}
+
+void
+CollectFiles (const std::string &path, std::vector<std::string> &files)
+{
+  struct stat st;
+  if (stat (path.c_str (), &st) != 0)
+    {
+      std::cerr << "Can't access " << path << std::endl;
+      return;
+    }
+  if (!S_ISDIR (st.st_mode))
+    {
+      files.push_back (path);
+      return;
+    }
+  DIR *dir = opendir (path.c_str ());
+  if (dir == nullptr)
+    {
+      return;
+    }
+  while (struct dirent *entry = readdir (dir))
+    {
+      std::string name = entry->d_name;
+      if (name == "." || name == "..")
+        {
+          continue;
+        }
+      std::string child = path + "/" + name;
+      if (stat (child.c_str (), &st) != 0)
+        {
+          continue;
+        }
+      if (S_ISDIR (st.st_mode))
+        {
+          CollectFiles (child, files);
+        }
+      else if ((name.size () > 5 && name.compare (name.size () - 5, 5, ".pcap") == 0)
+               || (name.size () > 8 && name.compare (name.size () - 8, 8, ".pcap.gz") == 0))
+        {
+          files.push_back (child);
+        }
+    }
+  closedir (dir);
+}
+
+void
+WriteFile (std::ostream &out, const FileResult &r)
+{
+  for (const auto &f : r.flows)
+    {
+      const FiveTuple &t = f.first;
+      const FlowKpi &k = f.second;
+      double duration = (k.last - k.first) * 1e-9;
+      out << r.file << ',' << FormatAddress (t.src) << ',' << FormatAddress (t.dst) << ','
+          << unsigned (t.protocol) << ',' << t.srcPort << ',' << t.dstPort << ',' << t.teid << ','
+          << k.packets << ',' << k.bytes << ',' << duration << ','
+          << (duration > 0 ? k.bytes * 8.0 / duration / 1e6 : 0) << ',' << k.iatMean * 1e-6 << ','
+          << (k.packets > 2 ? std::sqrt (k.iatM2 / (k.packets - 2)) * 1e-6 : 0) << ','
+          << k.iatMax * 1e-6 << ',';
+      if (k.seqPackets > 0 && k.seqValid)
+        {
+          uint64_t expected = uint64_t (k.seqMax) - k.seqMin + 1;
+          out << (expected > k.seqPackets ? expected - k.seqPackets : 0) << ',' << k.reordered
+              << ',' << k.delaySum / k.seqPackets * 1e-6;
+        }
+      else
+        {
+          out << ",,";
+        }
+      out << '\n';
+    }
+}
+
+void
+Usage ()
+{
+  std::cerr << "Usage: pcap-kpi [--threads=N] [--out=kpi.csv] [--seqPorts=p1,p2,..]"
+            << " <pcap file or directory>..." << std::endl;
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  unsigned threads = std::max (1u, std::thread::hardware_concurrency ());
+  std::string outFile = "-";
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare (0, 10, "--threads=") == 0)
+        {
+          threads = std::max (1, std::atoi (arg.c_str () + 10));
+        }
+      else if (arg.compare (0, 6, "--out=") == 0)
+        {
+          outFile = arg.substr (6);
+        }
+      else if (arg.compare (0, 11, "--seqPorts=") == 0)
+        {
+          std::stringstream ports (arg.substr (11));
+          std::string port;
+          while (std::getline (ports, port, ','))
+            {
+              char *end;
+              unsigned long value = std::strtoul (port.c_str (), &end, 10);
+              if (port.empty () || *end != 0 || value > 65535)
+                {
+                  std::cerr << "Invalid port " << port << " in " << arg << std::endl;
+                  return 1;
+                }
+              g_seqPorts.insert (value);
+            }
+        }
+      else if (arg == "--help" || arg == "-h")
+        {
+          Usage ();
+          return 0;
+        }
+      else
+        {
+          CollectFiles (arg, files);
+        }
+    }
+  if (files.empty ())
+    {
+      Usage ();
+      return 1;
+    }
+
+  std::vector<FileResult> results (files.size ());
+  for (size_t i = 0; i < files.size (); ++i)
+    {
+      results[i].file = files[i];
+    }
+  // Larger files first, so a big capture at the end does not run alone
+  std::vector<size_t> order (files.size ());
+  std::vector<off_t> sizes (files.size (), 0);
+  for (size_t i = 0; i < files.size (); ++i)
+    {
+      struct stat st;
+      sizes[i] = stat (files[i].c_str (), &st) == 0 ? st.st_size : 0;
+      order[i] = i;
+    }
+  std::sort (order.begin (), order.end (), [&sizes] (size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+  std::atomic<size_t> next (0);
+  std::vector<std::thread> pool;
+  for (unsigned i = 0; i < std::min<size_t> (threads, files.size ()); ++i)
+    {
+      pool.emplace_back ([&] () {
+        for (size_t j; (j = next++) < order.size ();)
+          {
+            AnalyzeFile (results[order[j]]);
+          }
+      });
+    }
+  for (std::thread &t : pool)
+    {
+      t.join ();
+    }
+
+  std::ofstream file;
+  if (outFile != "-")
+    {
+      file.open (outFile.c_str ());
+      if (!file.is_open ())
+        {
+          std::cerr << "Can't open " << outFile << std::endl;
+          return 1;
+        }
+    }
+  std::ostream &out = outFile == "-" ? std::cout : file;
+  out << "file,src,dst,proto,srcPort,dstPort,teid,packets,bytes,durationS,throughputMbps,"
+         "iatMeanMs,iatStdMs,iatMaxMs,seqLost,seqReordered,seqDelayMs\n";
+  uint64_t records = 0;
+  uint64_t skipped = 0;
+  int failed = 0;
+  for (const FileResult &r : results)
+    {
+      if (!r.error.empty ())
+        {
+          std::cerr << r.file << ": " << r.error << std::endl;
+          failed++;
+          continue;
+        }
+      WriteFile (out, r);
+      records += r.records;
+      skipped += r.skipped;
+    }
+  std::cerr << files.size () - failed << " files, " << records << " packets, " << skipped
+            << " not IPv4" << std::endl;
+  return failed == 0 ? 0 : 1;
+}
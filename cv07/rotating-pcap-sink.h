@@ -0,0 +1,611 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef ROTATING_PCAP_SINK_H
+#define ROTATING_PCAP_SINK_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+/**
+ * Lightweight replacement of PointToPointHelper::EnablePcapAll for long runs.
+ *
+ * The sink hooks the PromiscSniffer trace of one point-to-point device. On the
+ * simulator thread it only applies the optional five-tuple filter to the packet
+ * headers and copies the first SnapLen bytes of the packets it keeps into a
+ * single-producer single-consumer ring;
+ * one writer thread shared by all sinks drains the rings into the capture files.
+ * The file is rotated to prefix-node-device-N.pcap when it exceeds MaxFileBytes
+ * or covers more than MaxFileTime of simulation time, and can be compressed
+ * through a gzip child process. Call Close (or destroy the sink) after
+ * Simulator::Run to flush the files.
+ */
+class RotatingPcapSink : public SimpleRefCount<RotatingPcapSink>
+{
+public:
+  struct Options
+  {
+    uint32_t snapLen = 96;        // bytes kept of every packet, 0 keeps them whole
+    uint64_t maxFileBytes = 0;    // rotate after this many bytes, 0 never
+    Time maxFileTime = Seconds (0); // rotate after this much simulation time, 0 never
+    bool compress = false;        // write prefix-...-N.pcap.gz through gzip
+    /*
+     * Keep only matching IPv4 packets, e.g. "src=7.0.0.2,proto=17,dport=1100".
+     * Keys are src, dst, proto, sport and dport; empty keeps every packet.
+     */
+    std::string filter;
+  };
+
+  RotatingPcapSink (std::string prefix, Ptr<NetDevice> device, const Options &options);
+  ~RotatingPcapSink ();
+
+  void Close (void);
+  uint64_t GetCaptured (void) const;
+  uint64_t GetStalls (void) const;
+
+private:
+  friend class RotatingPcapWriter;
+
+  struct Filter
+  {
+    bool any = true;
+    uint32_t src = 0, dst = 0;
+    bool hasSrc = false, hasDst = false;
+    int proto = -1, sport = -1, dport = -1;
+  };
+
+  static const uint32_t SLOTS = 4096; // power of two
+  static const uint32_t MAX_PACKET = 65535;
+  static constexpr uint32_t FILTER_BYTES = 2 + 60 + 4; // PPP, longest IPv4 header, ports
+
+  static uint32_t ParseAddress (const std::string &key, const std::string &value);
+  static int ParseNumber (const std::string &key, const std::string &value, int max);
+
+  void Sniff (Ptr<const Packet> packet);
+  bool Match (const uint8_t *data, uint32_t length) const;
+  bool Drain (void);
+  bool Pending (void) const;
+  bool Open (void);
+  void CloseFile (void);
+
+  std::string m_prefix;
+  Ptr<NetDevice> m_device;         // 0 once closed
+  Options m_options;
+  Filter m_filter;
+  uint32_t m_slotData;             // captured bytes room per slot
+  uint32_t m_slotSize;
+  std::vector<uint8_t> m_ring;     // SLOTS slots: uint64 time [us], uint32 incl, uint32 orig, data
+  std::atomic<uint64_t> m_head;    // written by the simulator thread
+  std::atomic<uint64_t> m_tail;    // written by the writer thread
+  uint64_t m_captured;
+  uint64_t m_stalls;               // times the simulator thread waited for a full ring
+
+  // guarded by the writer mutex
+  bool m_closing;
+  bool m_closed;
+
+  // writer thread only
+  FILE *m_file;
+  pid_t m_gzip;                    // compressing child, -1 for plain files
+  bool m_first;
+  uint32_t m_fileIndex;
+  uint64_t m_fileBytes;
+  uint64_t m_fileStart;            // us
+};
+
+/**
+ * The writer thread of all RotatingPcapSinks. It drains every ring in turn and
+ * sleeps on a condition variable while all of them are empty; the simulator
+ * thread only takes the mutex to wake it up when it has gone to sleep. The
+ * thread is started by the first sink and ends once the last one is closed.
+ */
+class RotatingPcapWriter
+{
+public:
+  static RotatingPcapWriter &Get (void);
+
+  void Add (RotatingPcapSink *sink);
+  void Remove (RotatingPcapSink *sink);
+  void Wake (void);
+
+private:
+  RotatingPcapWriter ();
+  void Run (void);
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_closed;
+  std::atomic<bool> m_sleeping;
+  std::vector<RotatingPcapSink *> m_sinks;
+  std::vector<RotatingPcapSink *> m_snapshot; // writer thread only
+  std::thread m_thread;
+  bool m_running;
+};
+
+inline
+RotatingPcapSink::RotatingPcapSink (std::string prefix, Ptr<NetDevice> device, const Options &options)
+  : m_device (device),
+    m_options (options),
+    m_head (0),
+    m_tail (0),
+    m_captured (0),
+    m_stalls (0),
+    m_closing (false),
+    m_closed (false),
+    m_file (0),
+    m_gzip (-1),
+    m_first (true),
+    m_fileIndex (0),
+    m_fileBytes (0),
+    m_fileStart (0)
+{
+  std::ostringstream name;
+  name << prefix << "-" << device->GetNode ()->GetId () << "-" << device->GetIfIndex ();
+  m_prefix = name.str ();
+
+  std::stringstream items (options.filter);
+  std::string item;
+  while (std::getline (items, item, ','))
+    {
+      size_t eq = item.find ('=');
+      NS_ABORT_MSG_IF (eq == std::string::npos, "Invalid pcap filter item " << item);
+      std::string key = item.substr (0, eq);
+      std::string value = item.substr (eq + 1);
+      m_filter.any = false;
+      if (key == "src")
+        {
+          m_filter.src = ParseAddress (key, value);
+          m_filter.hasSrc = true;
+        }
+      else if (key == "dst")
+        {
+          m_filter.dst = ParseAddress (key, value);
+          m_filter.hasDst = true;
+        }
+      else if (key == "proto")
+        {
+          m_filter.proto = ParseNumber (key, value, 255);
+        }
+      else if (key == "sport")
+        {
+          m_filter.sport = ParseNumber (key, value, 65535);
+        }
+      else if (key == "dport")
+        {
+          m_filter.dport = ParseNumber (key, value, 65535);
+        }
+      else
+        {
+          NS_FATAL_ERROR ("Unknown pcap filter key " << key);
+        }
+    }
+
+  // a frame is never longer than the MTU plus the PPP header, so whole packets don't need 64 kB slots
+  m_slotData = std::min<uint32_t> (device->GetMtu () + 2, MAX_PACKET);
+  if (options.snapLen > 0)
+    {
+      m_slotData = std::min (m_slotData, options.snapLen);
+    }
+  m_slotSize = (16 + m_slotData + 7) & ~7u;
+  m_ring.resize (uint64_t (SLOTS) * m_slotSize);
+
+  NS_ABORT_MSG_UNLESS (Open (), "Can't open the capture file for " << m_prefix);
+  RotatingPcapWriter::Get ().Add (this);
+  device->TraceConnectWithoutContext ("PromiscSniffer", MakeCallback (&RotatingPcapSink::Sniff, this));
+}
+
+inline
+RotatingPcapSink::~RotatingPcapSink ()
+{
+  Close ();
+}
+
+inline void
+RotatingPcapSink::Close (void)
+{
+  if (m_device != 0)
+    {
+      m_device->TraceDisconnectWithoutContext ("PromiscSniffer", MakeCallback (&RotatingPcapSink::Sniff, this));
+      m_device = 0;
+    }
+  RotatingPcapWriter::Get ().Remove (this);
+}
+
+inline uint32_t
+RotatingPcapSink::ParseAddress (const std::string &key, const std::string &value)
+{
+  in_addr address;
+  NS_ABORT_MSG_UNLESS (inet_pton (AF_INET, value.c_str (), &address) == 1,
+                       "Invalid pcap filter " << key << "=" << value << ", expected an IPv4 address");
+  return ntohl (address.s_addr);
+}
+
+inline int
+RotatingPcapSink::ParseNumber (const std::string &key, const std::string &value, int max)
+{
+  // std::stoi would throw on garbage and accept trailing characters and signs
+  NS_ABORT_MSG_IF (value.empty () || value.size () > 5 || value.find_first_not_of ("0123456789") != std::string::npos,
+                   "Invalid pcap filter " << key << "=" << value << ", expected a number up to " << max);
+  int number = std::atoi (value.c_str ());
+  NS_ABORT_MSG_IF (number > max, "Invalid pcap filter " << key << "=" << value << ", expected a number up to " << max);
+  return number;
+}
+
+inline uint64_t
+RotatingPcapSink::GetCaptured (void) const
+{
+  return m_captured;
+}
+
+inline uint64_t
+RotatingPcapSink::GetStalls (void) const
+{
+  return m_stalls;
+}
+
+inline bool
+RotatingPcapSink::Match (const uint8_t *p, uint32_t n) const
+{
+  // 2 bytes of PPP protocol, then IPv4
+  if (n < 22 || p[0] != 0x00 || p[1] != 0x21)
+    {
+      return false;
+    }
+  p += 2;
+  uint32_t ihl = (p[0] & 0x0f) * 4;
+  uint32_t src = uint32_t (p[12]) << 24 | p[13] << 16 | p[14] << 8 | p[15];
+  uint32_t dst = uint32_t (p[16]) << 24 | p[17] << 16 | p[18] << 8 | p[19];
+  if ((m_filter.hasSrc && src != m_filter.src) || (m_filter.hasDst && dst != m_filter.dst)
+      || (m_filter.proto >= 0 && p[9] != m_filter.proto))
+    {
+      return false;
+    }
+  if (m_filter.sport < 0 && m_filter.dport < 0)
+    {
+      return true;
+    }
+  if ((p[9] != 6 && p[9] != 17) || n < 2 + ihl + 4)
+    {
+      return false;
+    }
+  int sport = p[ihl] << 8 | p[ihl + 1];
+  int dport = p[ihl + 2] << 8 | p[ihl + 3];
+  return (m_filter.sport < 0 || sport == m_filter.sport) && (m_filter.dport < 0 || dport == m_filter.dport);
+}
+
+inline void
+RotatingPcapSink::Sniff (Ptr<const Packet> packet)
+{
+  uint32_t orig = packet->GetSize ();
+  if (!m_filter.any)
+    {
+      // only the headers are copied for packets that are dropped, and before waiting for room
+      uint8_t headers[FILTER_BYTES];
+      if (!Match (headers, packet->CopyData (headers, std::min (orig, FILTER_BYTES))))
+        {
+          return;
+        }
+    }
+  uint64_t head = m_head.load (std::memory_order_relaxed);
+  if (head - m_tail.load (std::memory_order_acquire) == SLOTS)
+    {
+      m_stalls++;
+      while (head - m_tail.load (std::memory_order_acquire) == SLOTS)
+        {
+          std::this_thread::yield ();
+        }
+    }
+  uint8_t *slot = &m_ring[(head & (SLOTS - 1)) * m_slotSize];
+  // only the first snapLen bytes are serialized, the headers for the default snaplen
+  uint32_t incl = packet->CopyData (slot + 16, std::min (orig, m_slotData));
+  uint64_t us = Simulator::Now ().GetMicroSeconds ();
+  std::memcpy (slot, &us, 8);
+  std::memcpy (slot + 8, &incl, 4);
+  std::memcpy (slot + 12, &orig, 4);
+  // seq_cst pairs with the writer announcing it sleeps, so one of them sees the other
+  m_head.store (head + 1, std::memory_order_seq_cst);
+  m_captured++;
+  RotatingPcapWriter::Get ().Wake ();
+}
+
+inline bool
+RotatingPcapSink::Open (void)
+{
+  std::string name = m_prefix;
+  if (m_options.maxFileBytes > 0 || !m_options.maxFileTime.IsZero ())
+    {
+      name += "-" + std::to_string (m_fileIndex);
+    }
+  name += ".pcap";
+  if (m_options.compress)
+    {
+      // gzip writes to the already opened file, so no shell ever sees the file name
+      int out = open ((name + ".gz").c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (out < 0)
+        {
+          return false;
+        }
+      int in[2];
+      if (pipe2 (in, O_CLOEXEC) != 0)
+        {
+          close (out);
+          return false;
+        }
+      posix_spawn_file_actions_t actions;
+      posix_spawn_file_actions_init (&actions);
+      posix_spawn_file_actions_adddup2 (&actions, in[0], 0);
+      posix_spawn_file_actions_adddup2 (&actions, out, 1);
+      char *argv[] = {const_cast<char *> ("gzip"), const_cast<char *> ("-c"), 0};
+      int error = posix_spawnp (&m_gzip, "gzip", &actions, 0, argv, environ);
+      posix_spawn_file_actions_destroy (&actions);
+      close (in[0]);
+      close (out);
+      if (error != 0)
+        {
+          close (in[1]);
+          m_gzip = -1;
+          return false;
+        }
+      m_file = fdopen (in[1], "wb");
+    }
+  else
+    {
+      m_file = fopen (name.c_str (), "wb");
+    }
+  if (m_file == 0)
+    {
+      return false;
+    }
+  m_fileIndex++;
+  // pcap global header: microsecond timestamps, link type PPP like PointToPointHelper
+  uint32_t header[6] = {0xa1b2c3d4, 0x00040002, 0, 0, m_slotData, 9};
+  fwrite (header, sizeof (header), 1, m_file);
+  m_fileBytes = sizeof (header);
+  return true;
+}
+
+inline void
+RotatingPcapSink::CloseFile (void)
+{
+  if (m_file != 0)
+    {
+      fclose (m_file);
+      m_file = 0;
+    }
+  if (m_gzip > 0)
+    {
+      waitpid (m_gzip, 0, 0);
+      m_gzip = -1;
+    }
+}
+
+inline bool
+RotatingPcapSink::Pending (void) const
+{
+  return m_tail.load (std::memory_order_relaxed) != m_head.load (std::memory_order_seq_cst);
+}
+
+// Writes the records queued so far, returns whether there were any
+inline bool
+RotatingPcapSink::Drain (void)
+{
+  uint64_t tail = m_tail.load (std::memory_order_relaxed);
+  uint64_t head = m_head.load (std::memory_order_acquire);
+  if (tail == head)
+    {
+      return false;
+    }
+  if (m_file == 0)
+    {
+      // a rotation failed, keep the simulator thread from stalling on the full ring
+      m_tail.store (head, std::memory_order_release);
+      return true;
+    }
+  uint64_t maxTime = m_options.maxFileTime.GetMicroSeconds ();
+  for (; tail != head; ++tail)
+    {
+      const uint8_t *slot = &m_ring[(tail & (SLOTS - 1)) * m_slotSize];
+      uint64_t us;
+      uint32_t incl;
+      uint32_t orig;
+      std::memcpy (&us, slot, 8);
+      std::memcpy (&incl, slot + 8, 4);
+      std::memcpy (&orig, slot + 12, 4);
+      if (m_first)
+        {
+          m_fileStart = us;
+          m_first = false;
+        }
+      if ((m_options.maxFileBytes > 0 && m_fileBytes + 16 + incl > m_options.maxFileBytes && m_fileBytes > 24)
+          || (maxTime > 0 && us - m_fileStart >= maxTime))
+        {
+          CloseFile ();
+          if (!Open ())
+            {
+              std::cerr << "Can't open the next capture file for " << m_prefix << ", dropping the rest" << std::endl;
+              m_tail.store (head, std::memory_order_release);
+              return true;
+            }
+          m_fileStart = us;
+        }
+      uint32_t record[4] = {uint32_t (us / 1000000), uint32_t (us % 1000000), incl, orig};
+      fwrite (record, sizeof (record), 1, m_file);
+      fwrite (slot + 16, 1, incl, m_file);
+      m_fileBytes += sizeof (record) + incl;
+      m_tail.store (tail + 1, std::memory_order_release);
+    }
+  return true;
+}
+
+inline RotatingPcapWriter &
+RotatingPcapWriter::Get (void)
+{
+  // never destroyed, sinks may still be closed from static destructors
+  static RotatingPcapWriter *writer = new RotatingPcapWriter ();
+  return *writer;
+}
+
+inline
+RotatingPcapWriter::RotatingPcapWriter ()
+  : m_sleeping (false),
+    m_running (false)
+{
+}
+
+inline void
+RotatingPcapWriter::Add (RotatingPcapSink *sink)
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  m_sinks.push_back (sink);
+  if (!m_running)
+    {
+      if (m_thread.joinable ())
+        {
+          m_thread.join ();
+        }
+      m_running = true;
+      m_thread = std::thread (&RotatingPcapWriter::Run, this);
+    }
+}
+
+inline void
+RotatingPcapWriter::Remove (RotatingPcapSink *sink)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  if (sink->m_closed)
+    {
+      return;
+    }
+  sink->m_closing = true;
+  m_wake.notify_one ();
+  m_closed.wait (lock, [sink] { return sink->m_closed; });
+  if (!m_running && m_thread.joinable ())
+    {
+      m_thread.join ();
+    }
+}
+
+inline void
+RotatingPcapWriter::Wake (void)
+{
+  if (m_sleeping.load (std::memory_order_seq_cst))
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_wake.notify_one ();
+    }
+}
+
+inline void
+RotatingPcapWriter::Run (void)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (true)
+    {
+      m_snapshot = m_sinks;
+      lock.unlock ();
+      bool busy = false;
+      for (RotatingPcapSink *sink : m_snapshot)
+        {
+          busy |= sink->Drain ();
+        }
+      lock.lock ();
+
+      // the simulator thread is blocked in Close, so a closing ring only holds what was queued before
+      for (auto it = m_sinks.begin (); it != m_sinks.end ();)
+        {
+          RotatingPcapSink *sink = *it;
+          if (!sink->m_closing)
+            {
+              ++it;
+              continue;
+            }
+          while (sink->Drain ())
+            {
+            }
+          sink->CloseFile ();
+          sink->m_closed = true;
+          it = m_sinks.erase (it);
+          m_closed.notify_all ();
+        }
+      if (m_sinks.empty ())
+        {
+          m_running = false;
+          return;
+        }
+      if (busy)
+        {
+          continue;
+        }
+      m_sleeping.store (true, std::memory_order_seq_cst);
+      bool pending = false;
+      for (RotatingPcapSink *sink : m_sinks)
+        {
+          pending = pending || sink->Pending () || sink->m_closing;
+        }
+      if (!pending)
+        {
+          m_wake.wait (lock);
+        }
+      m_sleeping.store (false, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Installs a RotatingPcapSink on every point-to-point device of the simulation,
+ * which are the devices PointToPointHelper::EnablePcapAll would trace.
+ */
+inline std::vector<Ptr<RotatingPcapSink> >
+EnableRotatingPcapAll (std::string prefix, const RotatingPcapSink::Options &options)
+{
+  std::vector<Ptr<RotatingPcapSink> > sinks;
+  for (NodeList::Iterator node = NodeList::Begin (); node != NodeList::End (); ++node)
+    {
+      for (uint32_t i = 0; i < (*node)->GetNDevices (); ++i)
+        {
+          Ptr<NetDevice> device = (*node)->GetDevice (i);
+          if (DynamicCast<PointToPointNetDevice> (device))
+            {
+              sinks.push_back (Create<RotatingPcapSink> (prefix, device, options));
+            }
+        }
+    }
+  return sinks;
+}
+
+} // namespace ns3
+
+#endif /* ROTATING_PCAP_SINK_H */
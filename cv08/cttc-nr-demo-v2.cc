@@ -42,6 +42,10 @@ $ ./ns3 run "cttc-nr-demo --PrintHelp"
 #include "ns3/point-to-point-module.h"
 #include "ns3/netanim-module.h"
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+
 /*
  * Use, always, the namespace ns3. All the NR classes are inside such namespace.
  */
@@ -53,6 +57,243 @@ using namespace ns3;
  */
 NS_LOG_COMPONENT_DEFINE("CttcNrDemo");
 
+/**
+ * Traffic source driving many UDP flows from a single application and socket.
+ *
+ * Replaces one UdpClient per flow on the remote host. The flow state is kept in a
+ * structure-of-arrays table and the next send times of all flows in one min-heap, so the
+ * application schedules a single simulator event per distinct send time instead of one
+ * event per packet and flow. Each packet carries a SeqTsHeader like the ones of UdpClient,
+ * so UdpServer sinks and FlowMonitor see the same traffic.
+ */
+class MultiFlowUdpClient : public Application
+{
+  public:
+    enum Model
+    {
+        PERIODIC, // one packet every interval
+        POISSON,  // exponential inter-arrival times with the interval as mean
+        ON_OFF    // periodic during exponential on periods, silent during exponential off periods
+    };
+
+    static TypeId GetTypeId();
+    MultiFlowUdpClient();
+    ~MultiFlowUdpClient() override;
+
+    /**
+     * Add a flow towards remote:port, returns its index.
+     * For ON_OFF, onTime and offTime are the mean on and off durations.
+     */
+    uint32_t AddFlow(Ipv4Address remote,
+                     uint16_t port,
+                     uint32_t packetSize,
+                     Time interval,
+                     Model model,
+                     Time onTime = Seconds(0),
+                     Time offTime = Seconds(0));
+    uint32_t GetNFlows() const;
+    uint64_t GetSent(uint32_t flow) const;
+    int64_t AssignStreams(int64_t stream);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    void StartApplication() override;
+    void StopApplication() override;
+    void Wakeup();
+    void Push(uint32_t flow, Time when);
+    Time NextSend(uint32_t flow, Time now);
+
+    // flow table, one entry per flow in each array
+    std::vector<InetSocketAddress> m_remote;
+    std::vector<uint32_t> m_size;
+    std::vector<Time> m_interval;
+    std::vector<uint8_t> m_model;
+    std::vector<Time> m_onTime;
+    std::vector<Time> m_offTime;
+    std::vector<Time> m_onUntil; // end of the current on period (ON_OFF only)
+    std::vector<uint32_t> m_seq;
+
+    // (next send time in time steps, flow), ordered by time, then flow
+    std::vector<std::pair<int64_t, uint32_t>> m_heap;
+    EventId m_event;
+    Ptr<Socket> m_socket;
+    Ptr<ExponentialRandomVariable> m_exp;
+    TracedCallback<Ptr<const Packet>> m_txTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MultiFlowUdpClient);
+
+TypeId
+MultiFlowUdpClient::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::MultiFlowUdpClient")
+                            .SetParent<Application>()
+                            .AddConstructor<MultiFlowUdpClient>()
+                            .AddTraceSource("Tx",
+                                            "A new packet is sent by one of the flows",
+                                            MakeTraceSourceAccessor(&MultiFlowUdpClient::m_txTrace),
+                                            "ns3::Packet::TracedCallback");
+    return tid;
+}
+
+MultiFlowUdpClient::MultiFlowUdpClient()
+    : m_exp(CreateObject<ExponentialRandomVariable>())
+{
+}
+
+MultiFlowUdpClient::~MultiFlowUdpClient()
+{
+}
+
+void
+MultiFlowUdpClient::DoDispose()
+{
+    m_socket = nullptr;
+    Application::DoDispose();
+}
+
+uint32_t
+MultiFlowUdpClient::AddFlow(Ipv4Address remote,
+                            uint16_t port,
+                            uint32_t packetSize,
+                            Time interval,
+                            Model model,
+                            Time onTime,
+                            Time offTime)
+{
+    NS_ABORT_MSG_IF(interval.IsZero(), "The interval of a flow can't be zero");
+    NS_ABORT_MSG_IF(model == ON_OFF && (onTime.IsZero() || offTime.IsZero()),
+                    "On-off flows need non-zero mean on and off times");
+    m_remote.emplace_back(remote, port);
+    m_size.push_back(std::max<uint32_t>(packetSize, 12)); // room for the SeqTsHeader
+    m_interval.push_back(interval);
+    m_model.push_back(model);
+    m_onTime.push_back(onTime);
+    m_offTime.push_back(offTime);
+    m_onUntil.push_back(Seconds(0));
+    m_seq.push_back(0);
+    return m_remote.size() - 1;
+}
+
+uint32_t
+MultiFlowUdpClient::GetNFlows() const
+{
+    return m_remote.size();
+}
+
+uint64_t
+MultiFlowUdpClient::GetSent(uint32_t flow) const
+{
+    return m_seq[flow];
+}
+
+int64_t
+MultiFlowUdpClient::AssignStreams(int64_t stream)
+{
+    m_exp->SetStream(stream);
+    return 1;
+}
+
+void
+MultiFlowUdpClient::Push(uint32_t flow, Time when)
+{
+    m_heap.emplace_back(when.GetTimeStep(), flow);
+    std::push_heap(m_heap.begin(), m_heap.end(), std::greater<std::pair<int64_t, uint32_t>>());
+}
+
+Time
+MultiFlowUdpClient::NextSend(uint32_t flow, Time now)
+{
+    switch (m_model[flow])
+    {
+    case POISSON:
+        return now + Seconds(m_exp->GetValue(m_interval[flow].GetSeconds(), 0));
+    case ON_OFF: {
+        Time next = now + m_interval[flow];
+        if (next >= m_onUntil[flow])
+        {
+            // skip an off period, then start a new on period
+            next = m_onUntil[flow] + Seconds(m_exp->GetValue(m_offTime[flow].GetSeconds(), 0));
+            m_onUntil[flow] = next + Seconds(m_exp->GetValue(m_onTime[flow].GetSeconds(), 0));
+        }
+        return next;
+    }
+    default:
+        return now + m_interval[flow];
+    }
+}
+
+void
+MultiFlowUdpClient::StartApplication()
+{
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        if (m_socket->Bind() == -1)
+        {
+            NS_FATAL_ERROR("Failed to bind socket");
+        }
+        m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+        m_socket->SetAllowBroadcast(true);
+    }
+
+    // like UdpClient, every flow sends its first packet at the start; on-off flows start on
+    Time now = Simulator::Now();
+    m_heap.clear();
+    m_heap.reserve(m_remote.size());
+    for (uint32_t flow = 0; flow < m_remote.size(); ++flow)
+    {
+        if (m_model[flow] == ON_OFF)
+        {
+            m_onUntil[flow] = now + Seconds(m_exp->GetValue(m_onTime[flow].GetSeconds(), 0));
+        }
+        Push(flow, now);
+    }
+    if (!m_heap.empty())
+    {
+        m_event = Simulator::ScheduleNow(&MultiFlowUdpClient::Wakeup, this);
+    }
+}
+
+void
+MultiFlowUdpClient::StopApplication()
+{
+    Simulator::Cancel(m_event);
+    m_heap.clear();
+}
+
+void
+MultiFlowUdpClient::Wakeup()
+{
+    Time now = Simulator::Now();
+    int64_t nowStep = now.GetTimeStep();
+    auto later = std::greater<std::pair<int64_t, uint32_t>>();
+    // send for every flow due now, then a single event for the next distinct send time
+    while (!m_heap.empty() && m_heap.front().first <= nowStep)
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        uint32_t flow = m_heap.back().second;
+        m_heap.pop_back();
+
+        SeqTsHeader seqTs;
+        seqTs.SetSeq(m_seq[flow]++);
+        Ptr<Packet> p = Create<Packet>(m_size[flow] - 12); // 8+4 : the size of the seqTs header
+        p->AddHeader(seqTs);
+        m_txTrace(p);
+        m_socket->SendTo(p, 0, m_remote[flow]);
+
+        Push(flow, NextSend(flow, now));
+    }
+    if (!m_heap.empty())
+    {
+        m_event = Simulator::Schedule(TimeStep(m_heap.front().first) - now,
+                                      &MultiFlowUdpClient::Wakeup,
+                                      this);
+    }
+}
+
 int
 main(int argc, char* argv[])
 {
@@ -72,6 +313,17 @@ main(int argc, char* argv[])
     // Simulation parameters:
     Time simTime = MilliSeconds(2000);
     Time udpAppStartTime = MilliSeconds(400);
+    bool multiFlowClient = false;
+    std::string trafficModel = "periodic";
+    Time onTime = MilliSeconds(100);
+    Time offTime = MilliSeconds(100);
+    bool animationEnabled = true;
+    bool animPackets = true;
+    uint64_t animMaxPktsPerFile = 100000;
+    Time animPollInterval = Seconds(0.25);
+    Time beamformingPeriodicity = Seconds(0); // gNbs and UEs don't move
+    bool packetMetadata = false;
+    std::string scheduler = "ns3::NrMacSchedulerTdmaPF"; // NrHelper default
 
     // NR parameters. 
     uint16_t numerologyBwp1 = 4; //Numerology for BWP 1
@@ -108,6 +360,42 @@ main(int argc, char* argv[])
                  "Number of UDP packets in one second for best effor traffic",
                  lambdaBe);
     cmd.AddValue("simTime", "Simulation time", simTime);
+    cmd.AddValue("udpAppStartTime",
+                 "Start time of the UDP applications. Until then every BWP still processes "
+                 "each slot with nothing to send, so keep it as short as the attachment allows",
+                 udpAppStartTime);
+    cmd.AddValue("multiFlowClient",
+                 "Drive all DL flows from one MultiFlowUdpClient on the remote host instead of "
+                 "one UdpClient per UE",
+                 multiFlowClient);
+    cmd.AddValue("trafficModel",
+                 "Traffic model of the DL flows with multiFlowClient: periodic, poisson or onoff",
+                 trafficModel);
+    cmd.AddValue("onTime", "Mean on period of the onoff traffic model", onTime);
+    cmd.AddValue("offTime", "Mean off period of the onoff traffic model", offTime);
+    cmd.AddValue("animation", "Write the NetAnim trace", animationEnabled);
+    cmd.AddValue("animPackets",
+                 "animation: include the packet events, otherwise only nodes and positions",
+                 animPackets);
+    cmd.AddValue("animMaxPktsPerFile",
+                 "animation: packets per trace file before the next file is started",
+                 animMaxPktsPerFile);
+    cmd.AddValue("animPollInterval",
+                 "animation: interval between two position samples of the mobile nodes",
+                 animPollInterval);
+    cmd.AddValue("beamformingPeriodicity",
+                 "Interval between two runs of the beamforming method on all gNB/UE pairs, 0 "
+                 "computes the beams only once when the devices are installed",
+                 beamformingPeriodicity);
+    cmd.AddValue("packetMetadata",
+                 "Record the header/trailer metadata of every packet (Packet::EnableChecking and "
+                 "EnablePrinting), only needed to print packets while debugging",
+                 packetMetadata);
+    cmd.AddValue("scheduler",
+                 "Type of the gNB MAC scheduler. Another policy changes the resource allocation "
+                 "and thus the results, not only the cost: e.g. ns3::NrMacSchedulerTdmaRR keeps no "
+                 "per-UE metrics, but replaces proportional fair with round robin",
+                 scheduler);
     cmd.AddValue("numerologyBwp1", "The numerology to be used in bandwidth part 1", numerologyBwp1);
     cmd.AddValue("centralFrequencyBand1",
                  "The system frequency to be used in band 1",
@@ -136,6 +424,12 @@ main(int argc, char* argv[])
      */
     NS_ABORT_IF(centralFrequencyBand1 < 0.5e9 && centralFrequencyBand1 > 100e9);
     NS_ABORT_IF(centralFrequencyBand2 < 0.5e9 && centralFrequencyBand2 > 100e9);
+    NS_ABORT_MSG_IF(udpAppStartTime >= simTime, "udpAppStartTime must be before simTime");
+    NS_ABORT_MSG_IF(trafficModel != "periodic" && trafficModel != "poisson" &&
+                        trafficModel != "onoff",
+                    "Unknown trafficModel " << trafficModel);
+    NS_ABORT_MSG_IF(!multiFlowClient && trafficModel != "periodic",
+                    "trafficModel needs multiFlowClient, UdpClient only sends periodically");
 
     /*
      * If the logging variable is set to true, enable the log of some components
@@ -316,8 +610,12 @@ main(int argc, char* argv[])
      *
      */
 
-    Packet::EnableChecking();
-    Packet::EnablePrinting();
+    if (packetMetadata)
+    {
+        // Adds a metadata allocation to every packet and every header operation
+        Packet::EnableChecking();
+        Packet::EnablePrinting();
+    }
 
     /*
      *  Case (i): Attributes valid for all the nodes
@@ -325,6 +623,16 @@ main(int argc, char* argv[])
     // Beamforming method
     idealBeamformingHelper->SetAttribute("BeamformingMethod",
                                          TypeIdValue(DirectPathBeamforming::GetTypeId()));
+    // The beams depend only on the positions, recomputing them is pointless while nothing moves
+    idealBeamformingHelper->SetAttribute(
+        "BeamformingPeriodicity",
+        TimeValue(beamformingPeriodicity.IsZero() ? simTime : beamformingPeriodicity));
+
+    // Scheduler, the same for all BWPs. A subclass of NrMacSchedulerNs3 could be registered here
+    // too, but it only overrides the allocation hooks: the per-slot walk over the UE map that
+    // builds the active UEs is done by NrMacSchedulerNs3 itself, so an active-set scheduler with
+    // flat per-RNTI tables has to change that base class rather than be added from this script.
+    nrHelper->SetSchedulerTypeId(TypeId::LookupByName(scheduler));
 
     // Core latency
     epcHelper->SetAttribute("S1uLinkDelay", TimeValue(MilliSeconds(0)));
@@ -564,6 +872,25 @@ main(int argc, char* argv[])
      */
     ApplicationContainer clientApps;
 
+    // With multiFlowClient, one application on the remote host drives all the DL flows
+    Ptr<MultiFlowUdpClient> dlClients;
+    MultiFlowUdpClient::Model model = MultiFlowUdpClient::PERIODIC;
+    if (trafficModel == "poisson")
+    {
+        model = MultiFlowUdpClient::POISSON;
+    }
+    else if (trafficModel == "onoff")
+    {
+        model = MultiFlowUdpClient::ON_OFF;
+    }
+    if (multiFlowClient)
+    {
+        dlClients = CreateObject<MultiFlowUdpClient>();
+        remoteHost->AddApplication(dlClients);
+        randomStream += dlClients->AssignStreams(randomStream);
+        clientApps.Add(dlClients);
+    }
+
     for (uint32_t i = 0; i < ueLowLatContainer.GetN(); ++i)
     {
         Ptr<Node> ue = ueLowLatContainer.Get(i);
@@ -572,8 +899,21 @@ main(int argc, char* argv[])
 
         // The client, who is transmitting, is installed in the remote host,
         // with destination address set to the address of the UE
-        dlClientLowLat.SetAttribute("RemoteAddress", AddressValue(ueAddress));
-        clientApps.Add(dlClientLowLat.Install(remoteHost));
+        if (multiFlowClient)
+        {
+            dlClients->AddFlow(ueLowLatIpIface.GetAddress(i),
+                               dlPortLowLat,
+                               udpPacketSizeULL,
+                               Seconds(1.0 / lambdaULL),
+                               model,
+                               onTime,
+                               offTime);
+        }
+        else
+        {
+            dlClientLowLat.SetAttribute("RemoteAddress", AddressValue(ueAddress));
+            clientApps.Add(dlClientLowLat.Install(remoteHost));
+        }
 
         // Activate a dedicated bearer for the traffic type
         nrHelper->ActivateDedicatedEpsBearer(ueDevice, lowLatBearer, lowLatTft);
@@ -587,8 +927,21 @@ main(int argc, char* argv[])
 
         // The client, who is transmitting, is installed in the remote host,
         // with destination address set to the address of the UE
-        dlClientVoice.SetAttribute("RemoteAddress", AddressValue(ueAddress));
-        clientApps.Add(dlClientVoice.Install(remoteHost));
+        if (multiFlowClient)
+        {
+            dlClients->AddFlow(ueVoiceIpIface.GetAddress(i),
+                               dlPortVoice,
+                               udpPacketSizeBe,
+                               Seconds(1.0 / lambdaBe),
+                               model,
+                               onTime,
+                               offTime);
+        }
+        else
+        {
+            dlClientVoice.SetAttribute("RemoteAddress", AddressValue(ueAddress));
+            clientApps.Add(dlClientVoice.Install(remoteHost));
+        }
 
         // Activate a dedicated bearer for the traffic type
         nrHelper->ActivateDedicatedEpsBearer(ueDevice, voiceBearer, voiceTft);
@@ -618,7 +971,18 @@ main(int argc, char* argv[])
     monitor->SetAttribute("PacketSizeBinWidth", DoubleValue(20));
 
 
-    AnimationInterface animation("5g-nr.xml");
+    std::unique_ptr<AnimationInterface> animation;
+    if (animationEnabled)
+    {
+        animation = std::make_unique<AnimationInterface>("5g-nr.xml");
+        animation->SetMaxPktsPerTraceFile(animMaxPktsPerFile);
+        NS_ABORT_MSG_IF(!animPollInterval.IsStrictlyPositive(), "animPollInterval must be positive");
+        animation->SetMobilityPollInterval(animPollInterval);
+        if (!animPackets)
+        {
+            animation->SkipPacketTracing();
+        }
+    }
 
 
     Simulator::Stop(simTime);